@@ -0,0 +1,413 @@
+#include <Arduino.h>
+#include <RabirdToolkitConfigNonOS.h>
+#include <RabirdToolkitThirdParties.h>
+#include <RabirdToolkit.h>
+#include <RCoRoutine.h>
+#include <RMqttSN.h>
+#include <RMSNLocalGateway.h>
+#include <RMSNUtils.h>
+
+#include <RApplication.h>
+#include <RThread.h>
+#include <REventLoop.h>
+
+// Load settings, adjust them to the target board's memory.
+#define CLIENT_COUNT       2
+#define TOPIC_COUNT        3
+#define PUBLISH_QOS        RMSN_FLAG_QOS_1
+/// Publishes per second for each client
+#define PUBLISH_RATE       20
+/// Publish phase duration in milliseconds
+#define PUBLISH_DURATION   10000L
+#define PAYLOAD_SIZE       16
+/// Restart the gateway after the publish phase and measure the time until a
+/// publish is accepted again, 0 to skip it.
+#define RECONNECT_TEST     1
+/// Give up waiting for the reconnection after this many milliseconds
+#define RECONNECT_TIMEOUT  30000L
+/// Pause between publishes rejected while the session is renewed
+#define RECONNECT_RETRY    10
+
+// Stand-in gateway behaviour
+#define GATEWAY_LATENCY    2
+#define GATEWAY_LOSS       0
+#define GATEWAY_CONGESTION 0
+
+/// PUBACK latency histogram, one bucket per millisecond, the last bucket
+/// collects everything slower.
+#define LATENCY_BUCKETS 128
+
+struct VirtualClient
+{
+  RMSNClient       client;
+  RMSNLocalGateway gateway;
+  struct pt        pt;
+  char             clientId[8];
+  char             topicNames[TOPIC_COUNT][16];
+  uint8_t          topicIndex;
+  RMSNRequest      request;
+  uint32_t         startTime;
+  /// 0xFFFFFFFF if the session was never set up
+  uint32_t         connectTime;
+  uint32_t         sentTime;
+  uint32_t         lastPublishTime;
+  /// From the gateway restart to the first accepted publish
+  uint32_t         reconnectTime;
+  /// CONNACKs not accepted, or connect() refused
+  uint16_t         connectRejected;
+  uint16_t         published;
+  uint16_t         acked;
+  uint16_t         rejected;
+  uint16_t         timeouts;
+  bool             isFinished;
+};
+
+static PT_THREAD(virtualClientProcess(VirtualClient *vc));
+
+static VirtualClient *sClients[CLIENT_COUNT];
+static uint16_t       sLatencies[LATENCY_BUCKETS];
+static uint32_t       sPublishStartTime = 0;
+static uint32_t       sPublishEndTime   = 0;
+static bool           sIsReported       = false;
+
+static void
+recordLatency(uint32_t latency)
+{
+  if(latency >= LATENCY_BUCKETS)
+  {
+    latency = LATENCY_BUCKETS - 1;
+  }
+
+  ++sLatencies[latency];
+}
+
+/**
+ * @brief Find the latency of a permille rank
+ * @param permille 500 for p50, 999 for p999 ...
+ */
+static uint16_t
+latencyPercentile(uint32_t total, uint16_t permille)
+{
+  uint32_t rank  = (total * permille + 999) / 1000;
+  uint32_t count = 0;
+
+  for(uint16_t i = 0; i < LATENCY_BUCKETS; ++i)
+  {
+    count += sLatencies[i];
+
+    if((count > 0) && (count >= rank))
+    {
+      return i;
+    }
+  }
+
+  return LATENCY_BUCKETS - 1;
+}
+
+static void
+printReport()
+{
+  uint32_t connectMin      = 0xFFFFFFFF;
+  uint32_t connectMax      = 0;
+  uint32_t connectRejected = 0;
+  uint32_t reconnectMin    = 0xFFFFFFFF;
+  uint32_t reconnectMax    = 0;
+  uint32_t published       = 0;
+  uint32_t acked           = 0;
+  uint32_t rejected        = 0;
+  uint32_t timeouts        = 0;
+  uint32_t retransmits     = 0;
+  uint32_t elapsed         = sPublishEndTime - sPublishStartTime;
+
+  for(uint8_t i = 0; i < CLIENT_COUNT; ++i)
+  {
+    VirtualClient *vc = sClients[i];
+
+    if(0xFFFFFFFF != vc->connectTime)
+    {
+      connectMin = min(connectMin, vc->connectTime);
+      connectMax = max(connectMax, vc->connectTime);
+    }
+
+    reconnectMin     = min(reconnectMin, vc->reconnectTime);
+    reconnectMax     = max(reconnectMax, vc->reconnectTime);
+    connectRejected += vc->connectRejected;
+    published       += vc->published;
+    acked           += vc->acked;
+    rejected        += vc->rejected;
+    timeouts        += vc->timeouts;
+    retransmits     += vc->gateway.retransmits();
+  }
+
+  Serial.print(F("{\"clients\":"));
+  Serial.print(CLIENT_COUNT);
+  Serial.print(F(",\"topics\":"));
+  Serial.print(TOPIC_COUNT);
+  Serial.print(F(",\"qos\":"));
+  Serial.print((PUBLISH_QOS == RMSN_FLAG_QOS_M1) ? -1 : (PUBLISH_QOS >> 5));
+  Serial.print(F(",\"rate\":"));
+  Serial.print(PUBLISH_RATE);
+  Serial.print(F(",\"payload\":"));
+  Serial.print(PAYLOAD_SIZE);
+  Serial.print(F(",\"connect_ms\":{\"min\":"));
+  Serial.print(connectMin);
+  Serial.print(F(",\"max\":"));
+  Serial.print(connectMax);
+  Serial.print(F("},\"connect_rejected\":"));
+  Serial.print(connectRejected);
+  Serial.print(F(",\"reconnect_ms\":{\"min\":"));
+  Serial.print(reconnectMin);
+  Serial.print(F(",\"max\":"));
+  Serial.print(reconnectMax);
+  Serial.print(F("},\"duration_ms\":"));
+  Serial.print(elapsed);
+  Serial.print(F(",\"published\":"));
+  Serial.print(published);
+  Serial.print(F(",\"acked\":"));
+  Serial.print(acked);
+  Serial.print(F(",\"rejected\":"));
+  Serial.print(rejected);
+  Serial.print(F(",\"msgs_per_s\":"));
+  Serial.print(elapsed ? (published * 1000.0 / elapsed) : 0.0);
+  Serial.print(F(",\"puback_ms\":{\"p50\":"));
+  Serial.print(latencyPercentile(acked, 500));
+  Serial.print(F(",\"p99\":"));
+  Serial.print(latencyPercentile(acked, 990));
+  Serial.print(F(",\"p999\":"));
+  Serial.print(latencyPercentile(acked, 999));
+  Serial.print(F("},\"retransmits\":"));
+  Serial.print(retransmits);
+  Serial.print(F(",\"timeouts\":"));
+  Serial.print(timeouts);
+  Serial.println(F("}"));
+}
+
+/**
+ * @brief onApplicationIdle
+ */
+static void
+onApplicationIdle()
+{
+  bool isAllFinished = true;
+
+  for(uint8_t i = 0; i < CLIENT_COUNT; ++i)
+  {
+    VirtualClient *vc = sClients[i];
+
+    if(!vc->isFinished)
+    {
+      if(PT_EXITED <= virtualClientProcess(vc))
+      {
+        vc->isFinished = true;
+      }
+      else
+      {
+        isAllFinished = false;
+      }
+    }
+  }
+
+  if(isAllFinished && !sIsReported)
+  {
+    sIsReported = true;
+    printReport();
+  }
+}
+
+int
+rMain(int argc, rfchar *argv[])
+{
+  Serial.begin(115200);
+
+  while(!Serial)
+  {
+  }
+
+  Serial.println(F("RMqttSN library load generator example."));
+
+  // Application starts from here!
+  RApplication *app = new RApplication();
+
+  memset(sLatencies, 0, sizeof(sLatencies));
+
+  for(uint8_t i = 0; i < CLIENT_COUNT; ++i)
+  {
+    VirtualClient *vc = new VirtualClient();
+
+    vc->gateway.setLatency(GATEWAY_LATENCY);
+    vc->gateway.setLossRate(GATEWAY_LOSS);
+    vc->gateway.setCongestionRate(GATEWAY_CONGESTION);
+    vc->client.begin(&vc->gateway);
+    vc->client.setQos(PUBLISH_QOS);
+    vc->client.setAutoReconnect(true);
+
+    snprintf(vc->clientId, sizeof(vc->clientId), "load%u", i);
+
+    for(uint8_t j = 0; j < TOPIC_COUNT; ++j)
+    {
+      snprintf(vc->topicNames[j], sizeof(vc->topicNames[j]), "load/%u/%u", i,
+               j);
+    }
+
+    vc->connectTime     = 0xFFFFFFFF;
+    vc->reconnectTime   = 0;
+    vc->connectRejected = 0;
+    vc->published       = 0;
+    vc->acked           = 0;
+    vc->rejected        = 0;
+    vc->timeouts        = 0;
+    vc->isFinished      = false;
+    PT_INIT(&vc->pt);
+
+    sClients[i] = vc;
+  }
+
+  auto eventLoop = app->thread()->eventLoop();
+  eventLoop->idle.connect(onApplicationIdle);
+
+  return 0;
+}
+
+static PT_THREAD(virtualClientProcess(VirtualClient *vc))
+{
+  struct pt *pt = &vc->pt;
+
+  PT_BEGIN(pt);
+
+  vc->client.setClientId(vc->clientId);
+  vc->startTime = millis();
+  vc->request   = vc->client.connect();
+
+  // A refused connect() gives an invalid request, which is done already.
+  PT_WAIT_UNTIL(pt, vc->request.isDone());
+
+  if(RMSNRR_TIMEOUT == vc->request.result())
+  {
+    ++vc->timeouts;
+    PT_EXIT(pt);
+  }
+
+  if(RMSNRR_ACCEPTED != vc->request.result())
+  {
+    ++vc->connectRejected;
+    PT_EXIT(pt);
+  }
+
+  for(vc->topicIndex = 0; vc->topicIndex < TOPIC_COUNT; ++vc->topicIndex)
+  {
+    vc->request = vc->client.registerTopic(vc->topicNames[vc->topicIndex]);
+
+    PT_WAIT_UNTIL(pt, vc->request.isDone());
+
+    if(RMSNRR_TIMEOUT == vc->request.result())
+    {
+      ++vc->timeouts;
+      PT_EXIT(pt);
+    }
+
+    // Publishing to a topic without an id would only measure rejects.
+    if(RMSNRR_ACCEPTED != vc->request.result())
+    {
+      ++vc->rejected;
+      PT_EXIT(pt);
+    }
+  }
+
+  // Connect time covers the whole session setup, including registrations.
+  vc->connectTime = millis() - vc->startTime;
+
+  if(0 == sPublishStartTime)
+  {
+    sPublishStartTime = millis();
+  }
+
+  vc->startTime       = millis();
+  vc->lastPublishTime = vc->startTime;
+
+  while(millis() - vc->startTime < PUBLISH_DURATION)
+  {
+    PT_WAIT_UNTIL(pt, millis() - vc->lastPublishTime >= 1000 / PUBLISH_RATE);
+
+    vc->lastPublishTime += 1000 / PUBLISH_RATE;
+
+    {
+      const RMSNTopic *topic = vc->client.getTopicByName(
+        vc->topicNames[vc->published % TOPIC_COUNT]);
+      uint8_t payload[PAYLOAD_SIZE];
+
+      memset(payload, static_cast<uint8_t>(vc->published), PAYLOAD_SIZE);
+
+      vc->sentTime = millis();
+      vc->request  = vc->client.publish(topic->id, payload, PAYLOAD_SIZE);
+      ++vc->published;
+    }
+
+    PT_WAIT_UNTIL(pt, vc->request.isDone());
+
+    if(RMSNRR_TIMEOUT == vc->request.result())
+    {
+      ++vc->timeouts;
+    }
+    else if(RMSNRR_ACCEPTED != vc->request.result())
+    {
+      ++vc->rejected;
+    }
+    else if(fmsnIsHighQos(PUBLISH_QOS))
+    {
+      ++vc->acked;
+      recordLatency(millis() - vc->sentTime);
+    }
+  }
+
+  // Throughput only covers the publish phase.
+  sPublishEndTime = millis();
+
+#if RECONNECT_TEST
+  // The client reconnects and renews its session by itself. Publishes are
+  // retried until one is accepted, at QoS 0 until one is sent while
+  // connected.
+  vc->startTime = millis();
+  vc->gateway.restart();
+
+  PT_WAIT_UNTIL(pt, !vc->client.isConnected());
+
+  for(;;)
+  {
+    PT_WAIT_UNTIL(pt, vc->client.isConnected()
+                  || (millis() - vc->startTime >= RECONNECT_TIMEOUT));
+
+    if(millis() - vc->startTime >= RECONNECT_TIMEOUT)
+    {
+      vc->reconnectTime = 0xFFFFFFFF;
+      ++vc->timeouts;
+      break;
+    }
+
+    {
+      const RMSNTopic *topic = vc->client.getTopicByName(vc->topicNames[0]);
+      uint8_t payload[PAYLOAD_SIZE];
+
+      memset(payload, 0, PAYLOAD_SIZE);
+      vc->request = vc->client.publish(topic->id, payload, PAYLOAD_SIZE);
+    }
+
+    PT_WAIT_UNTIL(pt, vc->request.isDone());
+
+    if(RMSNRR_ACCEPTED == vc->request.result())
+    {
+      vc->reconnectTime = millis() - vc->startTime;
+      break;
+    }
+
+    vc->lastPublishTime = millis();
+
+    PT_WAIT_UNTIL(pt, millis() - vc->lastPublishTime >= RECONNECT_RETRY);
+  }
+#endif
+
+  vc->request = vc->client.disconnect();
+
+  PT_WAIT_UNTIL(pt, vc->request.isDone());
+
+  PT_END(pt);
+}
@@ -0,0 +1,256 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Fails if the client allocates from the heap while it connects, publishes,
+ * dispatches received frames or keeps the connection alive.
+ *
+ * malloc() and operator new are replaced by counting versions; each step
+ * runs against RMSNLocalGateway with counting on, see README.md for the
+ * build. The glibc allocator is called through its __libc_* names.
+ */
+
+#include <RMqttSN.h>
+#include <RMSNLocalGateway.h>
+#include <RHost.h>
+#include <new>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void  __libc_free(void *pointer);
+
+static volatile bool     sIsCounting  = false;
+static volatile uint32_t sAllocations = 0;
+
+static void *
+countAllocation(void *pointer)
+{
+  if(sIsCounting)
+  {
+    ++sAllocations;
+  }
+
+  return pointer;
+}
+
+extern "C" void *
+malloc(size_t size)
+{
+  return countAllocation(__libc_malloc(size));
+}
+
+extern "C" void *
+calloc(size_t count, size_t size)
+{
+  return countAllocation(__libc_calloc(count, size));
+}
+
+extern "C" void *
+realloc(void *pointer, size_t size)
+{
+  return countAllocation(__libc_realloc(pointer, size));
+}
+
+extern "C" void
+free(void *pointer)
+{
+  __libc_free(pointer);
+}
+
+void *
+operator new(size_t size)
+{
+  void *pointer = malloc(size);
+
+  if(!pointer)
+  {
+    throw std::bad_alloc();
+  }
+
+  return pointer;
+}
+
+void *
+operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void *
+operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return malloc(size);
+}
+
+void *
+operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return malloc(size);
+}
+
+void
+operator delete(void *pointer) noexcept
+{
+  free(pointer);
+}
+
+void
+operator delete[](void *pointer) noexcept
+{
+  free(pointer);
+}
+
+void
+operator delete(void *pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+void
+operator delete[](void *pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+static const char *sClientId  = "alloc";
+static const char *sOutTopic  = "alloc/out";
+static const char *sInTopic   = "alloc/in";
+static uint16_t    sDelivered = 0;
+static int         sFailures  = 0;
+
+static void
+onReceived(const RMSNMsgHeader *msg)
+{
+  if(RMSNMT_PUBLISH == msg->type)
+  {
+    ++sDelivered;
+  }
+}
+
+static RMSNRequestResult
+waitFor(const RMSNRequest &request)
+{
+  for(uint16_t i = 0; (i < 1000) && !request.isDone(); ++i)
+  {
+    rHostAdvance(1);
+  }
+
+  return request.result();
+}
+
+static void
+beginStep()
+{
+  sAllocations = 0;
+  sIsCounting  = true;
+}
+
+static void
+endStep(const char *step, const bool isDone)
+{
+  sIsCounting = false;
+
+  if(!isDone || (sAllocations > 0))
+  {
+    ++sFailures;
+  }
+
+  printf("%-10s %s, %u allocations\n", step, isDone ? "done" : "FAILED",
+         static_cast<unsigned>(sAllocations));
+}
+
+int
+main()
+{
+  // stdio allocates its buffer on first use.
+  printf("Heap use of the client hot paths\n");
+
+  RMSNLocalGateway gateway;
+  RMSNClient       client;
+  uint8_t          payload[RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish)];
+
+  memset(payload, 0x5A, sizeof(payload));
+  client.begin(&gateway);
+  client.setQos(RMSN_FLAG_QOS_1);
+  client.received.connect(onReceived);
+
+  beginStep();
+  client.setClientId(sClientId);
+  endStep("connect",
+          RMSNRR_ACCEPTED == waitFor(client.connect()) && client.isConnected());
+
+  beginStep();
+  endStep("register",
+          RMSNRR_ACCEPTED == waitFor(client.registerTopic(sOutTopic)));
+
+  const uint16_t outTopicId = client.getTopicByName(sOutTopic)->id;
+
+  beginStep();
+  bool isPublished = true;
+
+  for(uint8_t i = 0; i < 100; ++i)
+  {
+    isPublished = isPublished && (RMSNRR_ACCEPTED == waitFor(
+                                    client.publish(outTopicId, payload,
+                                                   sizeof(payload))));
+  }
+
+  // setQos() only adds QoS bits, a template publishes at QoS 0 for sure.
+  isPublished = isPublished && (RMSNRR_ACCEPTED == waitFor(client.publish(
+                                  client.publishTemplate(outTopicId,
+                                                         RMSN_FLAG_QOS_0),
+                                  payload, 8)));
+  endStep("publish", isPublished);
+
+  beginStep();
+  bool isDispatched =
+    (RMSNRR_ACCEPTED == waitFor(client.subscribeByName(sInTopic)));
+  const RMSNTopic *inTopic = client.getTopicByName(sInTopic);
+
+  for(uint8_t i = 0; isDispatched && (i < 100); ++i)
+  {
+    gateway.publish(inTopic->id, payload, sizeof(payload));
+    rHostAdvance(1);
+  }
+
+  endStep("dispatch", isDispatched && (100 == sDelivered));
+
+  beginStep();
+  bool isAlive = true;
+
+  for(uint8_t i = 0; i < 10; ++i)
+  {
+    rHostAdvance(client.keepAliveInterval() * 1000UL);
+    isAlive = isAlive && (RMSNRR_ACCEPTED == waitFor(client.pingReq(
+                                                        sClientId)));
+  }
+
+  endStep("keep-alive", isAlive && client.isConnected());
+
+  beginStep();
+  endStep("disconnect", RMSNRR_ACCEPTED == waitFor(client.disconnect()));
+
+  return (0 == sFailures) ? 0 : 1;
+}
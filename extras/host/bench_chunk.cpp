@@ -0,0 +1,258 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Effective throughput of RMSNChunkPublisher for different chunk sizes.
+ *
+ * A 3000 bytes payload is published through RMSNLocalGateway, which routes
+ * it back to the client where RMSNChunkAssembler checks it arrived intact.
+ * Time is simulated: each frame the client sends takes its serial wire time
+ * at the given baud rate, each response the gateway latency. Frames and
+ * wire bytes are the ones the client sent.
+ *
+ *     bench_chunk [baud [latency_ms]]
+ */
+
+#include <RMqttSN.h>
+#include <RMSNChunk.h>
+#include <RMSNLocalGateway.h>
+#include <RHost.h>
+#include <time.h>
+
+#define PAYLOAD_SIZE 3000
+/// Bits on the wire per byte, 8N1
+#define BITS_PER_BYTE 10
+
+/**
+ * @brief Counts the bytes the client writes to the gateway
+ */
+class LinkStream : public Stream
+{
+public:
+  LinkStream(RMSNLocalGateway *gateway) : mGateway(gateway), mBytes(0) {}
+
+  int
+  available()
+  {
+    return mGateway->available();
+  }
+
+  int
+  read()
+  {
+    return mGateway->read();
+  }
+
+  int
+  peek()
+  {
+    return mGateway->peek();
+  }
+
+  size_t
+  write(uint8_t c)
+  {
+    ++mBytes;
+    return mGateway->write(c);
+  }
+
+  size_t
+  write(const uint8_t *buffer, size_t size)
+  {
+    mBytes += size;
+    return mGateway->write(buffer, size);
+  }
+
+  void
+  flush()
+  {
+    mGateway->flush();
+  }
+
+  /// Bytes written since the last call
+  uint32_t
+  takeBytes()
+  {
+    const uint32_t bytes = mBytes;
+
+    mBytes = 0;
+    return bytes;
+  }
+
+private:
+  RMSNLocalGateway *mGateway;
+  uint32_t          mBytes;
+};
+
+static uint8_t            sPayload[PAYLOAD_SIZE];
+static uint8_t            sArena[PAYLOAD_SIZE];
+static RMSNChunkAssembler sAssembler(sArena, sizeof(sArena));
+static bool               sIsIntact = false;
+
+static void
+onReceived(const RMSNMsgHeader *msg)
+{
+  if((RMSNMT_PUBLISH == msg->type)
+     && (RMSNCR_COMPLETE == sAssembler.feed(
+           reinterpret_cast<const RMSNMsgPublish *>(msg))))
+  {
+    sIsIntact = (sAssembler.size() == PAYLOAD_SIZE)
+                && (0 == memcmp(sAssembler.data(), sPayload, PAYLOAD_SIZE));
+  }
+}
+
+static uint32_t
+cpuMicros()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+  return now.tv_sec * 1000000UL + now.tv_nsec / 1000;
+}
+
+static void
+run(const uint8_t qos, const uint8_t chunkSize, const uint32_t baud,
+    const uint16_t latency)
+{
+  RMSNLocalGateway   gateway;
+  LinkStream         link(&gateway);
+  RMSNClient         client;
+  RMSNChunkPublisher publisher(&client);
+  char               topicName[] = "bench/chunk";
+
+  gateway.setLatency(latency);
+  client.begin(&link);
+  client.setClientId("chunk");
+  client.received.connect(onReceived);
+
+  RMSNRequest request = client.connect();
+
+  while(!request.isDone())
+  {
+    rHostAdvance(1);
+  }
+
+  // Chunks come back at QoS 0, only the publishing side is measured.
+  client.setQos(RMSN_FLAG_QOS_0);
+  request = client.subscribeByName(topicName);
+
+  while(!request.isDone())
+  {
+    rHostAdvance(1);
+  }
+
+  client.setQos(qos);
+
+  const uint16_t topicId = client.getTopicByName(topicName)->id;
+
+  sAssembler.reset();
+  sIsIntact = false;
+  link.takeBytes();
+  gateway.resetCounters();
+  publisher.begin(topicId, sPayload, PAYLOAD_SIZE, chunkSize);
+
+  const uint32_t startTime    = millis();
+  const uint32_t startCpuTime = cpuMicros();
+  uint32_t       wireMicros   = 0;
+  uint32_t       wireBytes    = 0;
+  bool           isBusy       = true;
+
+  // Until the last chunk is acknowledged and routed back, or a minute of
+  // simulated time passed.
+  while((isBusy || !sIsIntact) && (millis() - startTime < 60000))
+  {
+    isBusy = publisher.process();
+
+    const uint32_t bytes = link.takeBytes();
+
+    wireBytes  += bytes;
+    wireMicros += bytes * BITS_PER_BYTE * 1000000ULL / baud;
+
+    if(wireMicros >= 1000)
+    {
+      rHostAdvance(wireMicros / 1000);
+      wireMicros %= 1000;
+    }
+    else if(0 == bytes)
+    {
+      // Waiting for a response.
+      rHostAdvance(1);
+    }
+    else
+    {
+      rHostProcessEvents();
+    }
+  }
+
+  const uint32_t elapsed = millis() - startTime;
+  const uint32_t cpuTime = cpuMicros() - startCpuTime;
+
+  printf("%5u %4u %7u %8u %9.1f%% %9u %11.0f %9u %s\n",
+         static_cast<unsigned>(chunkSize),
+         (RMSN_FLAG_QOS_1 == qos) ? 1 : 0,
+         static_cast<unsigned>(gateway.framesReceived()),
+         static_cast<unsigned>(wireBytes),
+         wireBytes ? PAYLOAD_SIZE * 100.0 / wireBytes : 0.0,
+         static_cast<unsigned>(elapsed),
+         elapsed ? PAYLOAD_SIZE * 1000.0 / elapsed : 0.0,
+         static_cast<unsigned>(cpuTime),
+         publisher.isFailed() ? "failed" : (sIsIntact ? "intact" : "lost"));
+
+  client.disconnect();
+}
+
+int
+main(int argc, char *argv[])
+{
+  const uint32_t baud    = (argc > 1) ? strtoul(argv[1], NULL, 10) : 115200;
+  const uint16_t latency = (argc > 2) ? strtoul(argv[2], NULL, 10) : 2;
+  // 0 takes the largest chunk fitting into a frame.
+  const uint8_t  chunkSizes[] = {8, 16, 24, 32, 40, 48, 0};
+
+  rHostFreezeClock();
+  srand(1);
+
+  for(uint16_t i = 0; i < PAYLOAD_SIZE; ++i)
+  {
+    sPayload[i] = static_cast<uint8_t>(rand());
+  }
+
+  printf("%u bytes payload, %u baud, %u ms gateway latency\n",
+         PAYLOAD_SIZE, static_cast<unsigned>(baud),
+         static_cast<unsigned>(latency));
+  printf("chunk  qos  frames wire_B  payload/wire    sim_ms  payload_B/s"
+         "    cpu_us\n");
+
+  for(uint8_t qos = 0; qos < 2; ++qos)
+  {
+    for(uint8_t i = 0; i < sizeof(chunkSizes); ++i)
+    {
+      run(qos ? RMSN_FLAG_QOS_1 : RMSN_FLAG_QOS_0, chunkSizes[i], baud,
+          latency);
+    }
+  }
+
+  return 0;
+}
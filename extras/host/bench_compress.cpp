@@ -0,0 +1,367 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Compression ratio and speed of RMSNCodec on recorded payloads.
+ *
+ * Payloads come from a capture written by RMSNCaptureStream, taken without
+ * a codec: the PUBLISH frames the client sent, one series per topic, the
+ * RMSN_CODEC_MAX_TOPICS busiest topics. Without a capture, synthetic
+ * telemetry series stand in, slowly drifting sensor records like the ones
+ * the codec is meant for.
+ *
+ *     bench_compress [capture.rcp]
+ */
+
+#include <RMqttSN.h>
+#include <RMSNCodec.h>
+#include <RMSNCaptureStream.h>
+#include <RByteOrder.h>
+#include <time.h>
+
+#define MAX_PAYLOADS 4096
+
+struct Series
+{
+  const char *name;
+  uint16_t    topicId;
+  uint16_t    count;
+  uint8_t     lengths[MAX_PAYLOADS];
+  uint8_t     payloads[MAX_PAYLOADS][RMSN_CODEC_MAX_VALUE_SIZE];
+};
+
+static Series sSeries[RMSN_CODEC_MAX_TOPICS];
+static uint8_t sSeriesCount = 0;
+
+static Series *
+addSeries(const char *name, const uint16_t topicId)
+{
+  Series *series = &sSeries[sSeriesCount++];
+
+  series->name    = name;
+  series->topicId = topicId;
+  series->count   = 0;
+
+  return series;
+}
+
+static void
+append(Series *series, const void *payload, const uint8_t length)
+{
+  if((series->count < MAX_PAYLOADS) && (length <= RMSN_CODEC_MAX_VALUE_SIZE))
+  {
+    memcpy(series->payloads[series->count], payload, length);
+    series->lengths[series->count++] = length;
+  }
+}
+
+/// Weather node: timestamp, temperature, humidity, pressure, battery.
+struct WeatherRecord
+{
+  uint32_t time;
+  int16_t  temperature;
+  uint16_t humidity;
+  uint32_t pressure;
+  uint16_t battery;
+  uint8_t  status;
+} RMSN_STRUCT_PACKED;
+
+/// Vibration monitor: three axes of an accelerometer and a counter.
+struct MotionRecord
+{
+  uint16_t sample;
+  int16_t  axes[3];
+  uint16_t peak;
+} RMSN_STRUCT_PACKED;
+
+/// Energy meter: cumulative counters and instant power.
+struct MeterRecord
+{
+  uint32_t time;
+  uint32_t energy[3];
+  uint16_t power[3];
+  uint16_t voltage;
+  uint8_t  flags;
+} RMSN_STRUCT_PACKED;
+
+static int32_t
+drift(int32_t value, const int32_t step)
+{
+  return value + rand() % (2 * step + 1) - step;
+}
+
+static void
+synthesize()
+{
+  Series       *weather = addSeries("weather", 1);
+  Series       *motion  = addSeries("motion", 2);
+  Series       *meter   = addSeries("meter", 3);
+  WeatherRecord w       = {1500000000UL, 2150, 4520, 101325, 3300, 0};
+  MotionRecord  m       = {0, {0, 0, 1000}, 0};
+  MeterRecord   e       = {1500000000UL, {120000, 98000, 143000},
+                           {450, 380, 620}, 2300, 0};
+
+  srand(1);
+
+  for(uint16_t i = 0; i < MAX_PAYLOADS; ++i)
+  {
+    w.time       += 10;
+    w.temperature = drift(w.temperature, 3);
+    w.humidity    = drift(w.humidity, 5);
+    w.pressure    = drift(w.pressure, 2);
+    w.battery    -= ((i % 64) == 0);
+    append(weather, &w, sizeof(w));
+
+    ++m.sample;
+
+    for(uint8_t axis = 0; axis < 3; ++axis)
+    {
+      m.axes[axis] = drift(axis == 2 ? 1000 : 0, 40);
+    }
+
+    if(abs(m.axes[0]) > m.peak)
+    {
+      m.peak = abs(m.axes[0]);
+    }
+    append(motion, &m, sizeof(m));
+
+    e.time += 60;
+
+    for(uint8_t phase = 0; phase < 3; ++phase)
+    {
+      e.power[phase]   = drift(e.power[phase], 8);
+      e.energy[phase] += e.power[phase] / 60;
+    }
+
+    e.voltage = drift(2300, 4);
+    append(meter, &e, sizeof(e));
+  }
+}
+
+static bool
+load(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  char  magic[4];
+
+  if(!file)
+  {
+    return false;
+  }
+
+  if((fread(magic, 1, sizeof(magic), file) != sizeof(magic))
+     || memcmp(magic, RMSN_CAPTURE_MAGIC, sizeof(magic)))
+  {
+    fclose(file);
+    return false;
+  }
+
+  // First pass counts publishes per topic, the second one keeps the
+  // busiest topics.
+  static uint16_t counts[0x10000];
+  static uint8_t  frame[RMSN_MAX_BUFFER_SIZE];
+  const long      start = ftell(file);
+
+  for(uint8_t pass = 0; pass < 2; ++pass)
+  {
+    uint8_t record[5];
+
+    fseek(file, start, SEEK_SET);
+
+    while(fread(record, 1, sizeof(record), file) == sizeof(record))
+    {
+      const int length = fgetc(file);
+
+      // The 3 bytes length form is never captured, see RMSNCaptureFrame.
+      if((length < 2) || (fread(frame + 1, 1, length - 1, file)
+                          != static_cast<size_t>(length - 1)))
+      {
+        break;
+      }
+
+      frame[0] = length;
+
+      const RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(frame);
+
+      if((RMSNCD_TX != record[4]) || (RMSNMT_PUBLISH != msg->type)
+         || (length < static_cast<int>(sizeof(RMSNMsgPublish))))
+      {
+        continue;
+      }
+
+      const uint16_t topicId = rNtohs(msg->topicId);
+
+      if(0 == pass)
+      {
+        ++counts[topicId];
+        continue;
+      }
+
+      for(uint8_t i = 0; i < sSeriesCount; ++i)
+      {
+        if(sSeries[i].topicId == topicId)
+        {
+          append(&sSeries[i], msg->data, length - sizeof(RMSNMsgPublish));
+        }
+      }
+    }
+
+    while((0 == pass) && (sSeriesCount < RMSN_CODEC_MAX_TOPICS))
+    {
+      uint32_t busiest = 0;
+
+      for(uint32_t topicId = 1; topicId < 0x10000; ++topicId)
+      {
+        busiest = (counts[topicId] > counts[busiest]) ? topicId : busiest;
+      }
+
+      if(counts[busiest] < 2)
+      {
+        break;
+      }
+
+      addSeries("captured", busiest);
+      counts[busiest] = 0;
+    }
+  }
+
+  fclose(file);
+
+  return sSeriesCount > 0;
+}
+
+static uint64_t
+nowNanos()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/// Encode and decode the series once, false if a payload did not survive.
+static bool
+roundTrip(const Series *series, uint32_t *rawBytes, uint32_t *encodedBytes,
+          uint64_t *encodeNanos, uint64_t *decodeNanos)
+{
+  static uint8_t encoded[MAX_PAYLOADS][RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish)];
+  static uint8_t encodedLengths[MAX_PAYLOADS];
+  RMSNCodec      encoder;
+  RMSNCodec      decoder;
+  uint64_t       startTime = nowNanos();
+
+  encoder.addTopic(series->topicId);
+  decoder.addTopic(series->topicId);
+
+  for(uint16_t i = 0; i < series->count; ++i)
+  {
+    memcpy(encoded[i], series->payloads[i], series->lengths[i]);
+    encodedLengths[i] = encoder.encode(series->topicId, encoded[i],
+                                       series->lengths[i],
+                                       sizeof(encoded[i]));
+  }
+
+  *encodeNanos += nowNanos() - startTime;
+  startTime     = nowNanos();
+
+  for(uint16_t i = 0; i < series->count; ++i)
+  {
+    if(decoder.decode(series->topicId, encoded[i], encodedLengths[i],
+                      sizeof(encoded[i])) != series->lengths[i])
+    {
+      return false;
+    }
+  }
+
+  *decodeNanos += nowNanos() - startTime;
+  *rawBytes     = 0;
+  *encodedBytes = 0;
+
+  for(uint16_t i = 0; i < series->count; ++i)
+  {
+    if(memcmp(encoded[i], series->payloads[i], series->lengths[i]))
+    {
+      return false;
+    }
+
+    *rawBytes     += series->lengths[i];
+    *encodedBytes += encodedLengths[i];
+  }
+
+  return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc > 1)
+  {
+    if(!load(argv[1]))
+    {
+      fprintf(stderr, "%s: no publishes in capture\n", argv[1]);
+      return 1;
+    }
+  }
+  else
+  {
+    synthesize();
+  }
+
+  printf("series    topic payloads    raw_B encoded_B  ratio"
+         "  encode_MB/s  decode_MB/s\n");
+
+  for(uint8_t i = 0; i < sSeriesCount; ++i)
+  {
+    const Series *series       = &sSeries[i];
+    uint32_t      rawBytes     = 0;
+    uint32_t      encodedBytes = 0;
+    uint64_t      encodeNanos  = 0;
+    uint64_t      decodeNanos  = 0;
+    uint32_t      rounds       = 0;
+
+    // Enough rounds for a stable time, at least a tenth of a second.
+    while((encodeNanos + decodeNanos < 100000000ULL) || (rounds < 10))
+    {
+      if(!roundTrip(series, &rawBytes, &encodedBytes, &encodeNanos,
+                    &decodeNanos))
+      {
+        printf("%-9s %5u round trip FAILED\n", series->name,
+               series->topicId);
+        return 1;
+      }
+
+      ++rounds;
+    }
+
+    printf("%-9s %5u %8u %8u %9u %5.2f %12.1f %12.1f\n", series->name,
+           series->topicId, series->count, static_cast<unsigned>(rawBytes),
+           static_cast<unsigned>(encodedBytes),
+           static_cast<double>(rawBytes) / encodedBytes,
+           rawBytes * 1000.0 * rounds / encodeNanos,
+           rawBytes * 1000.0 * rounds / decodeNanos);
+  }
+
+  return 0;
+}
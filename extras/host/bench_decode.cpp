@@ -0,0 +1,258 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Receive throughput of parseStream() in MB/s.
+ *
+ * Three streams are replayed from memory to a connected client: publishes
+ * as large as the receive buffer takes, short publishes, and random bytes.
+ * The valid streams only use calls older trees have too, so the cost of
+ * the receive path checks can be compared, see README.md.
+ *
+ *     bench_decode [megabytes]
+ */
+
+#include <RMqttSN.h>
+#include <RMSNLocalGateway.h>
+#include <RHost.h>
+#include <time.h>
+
+#define STREAM_SIZE 4096
+
+/**
+ * @brief Writes to the gateway, reads from the gateway or, once replaying,
+ * from a buffer over and over.
+ */
+class ReplayStream : public Stream
+{
+public:
+  ReplayStream(RMSNLocalGateway *gateway)
+    : mGateway(gateway), mData(NULL), mSize(0), mPos(0), mBytes(0)
+  {
+  }
+
+  void
+  replay(const uint8_t *data, size_t size)
+  {
+    mData  = data;
+    mSize  = size;
+    mPos   = 0;
+    mBytes = 0;
+  }
+
+  /// Bytes read since replay()
+  uint64_t
+  bytes() const
+  {
+    return mBytes;
+  }
+
+  int
+  available()
+  {
+    return mData ? static_cast<int>(mSize - mPos) : mGateway->available();
+  }
+
+  int
+  read()
+  {
+    if(!mData)
+    {
+      return mGateway->read();
+    }
+
+    const uint8_t c = mData[mPos];
+
+    ++mBytes;
+
+    if(++mPos >= mSize)
+    {
+      mPos = 0;
+    }
+
+    return c;
+  }
+
+  int
+  peek()
+  {
+    return mData ? mData[mPos] : mGateway->peek();
+  }
+
+  size_t
+  write(uint8_t c)
+  {
+    return mGateway->write(c);
+  }
+
+  size_t
+  write(const uint8_t *buffer, size_t size)
+  {
+    return mGateway->write(buffer, size);
+  }
+
+  void
+  flush()
+  {
+    mGateway->flush();
+  }
+
+private:
+  RMSNLocalGateway *mGateway;
+  const uint8_t    *mData;
+  size_t            mSize;
+  size_t            mPos;
+  uint64_t          mBytes;
+};
+
+static uint8_t  sStream[STREAM_SIZE];
+static uint32_t sPublishes = 0;
+
+static void
+onReceived(const RMSNMsgHeader *msg)
+{
+  if(RMSNMT_PUBLISH == msg->type)
+  {
+    ++sPublishes;
+  }
+}
+
+static void
+settle()
+{
+  for(uint8_t i = 0; i < 100; ++i)
+  {
+    rHostAdvance(1);
+  }
+}
+
+static uint64_t
+nanos()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/// Fill the stream with QoS 0 publishes of frameLength bytes, the last one
+/// padded with a shorter publish so the stream loops on a frame boundary.
+/// @return Bytes of the stream used.
+static size_t
+fillPublishes(const uint16_t topicId, const uint8_t frameLength)
+{
+  size_t size = 0;
+
+  while(size + frameLength <= sizeof(sStream))
+  {
+    uint8_t *frame = sStream + size;
+
+    frame[0] = frameLength;
+    frame[1] = RMSNMT_PUBLISH;
+    frame[2] = RMSN_FLAG_QOS_0;
+    frame[3] = static_cast<uint8_t>(topicId >> 8);
+    frame[4] = static_cast<uint8_t>(topicId);
+    frame[5] = 0;
+    frame[6] = 0;
+
+    for(uint8_t i = 7; i < frameLength; ++i)
+    {
+      frame[i] = static_cast<uint8_t>(rand());
+    }
+
+    size += frameLength;
+  }
+
+  return size;
+}
+
+static void
+run(RMSNClient *client, ReplayStream *stream, const char *name,
+    const size_t size, const uint64_t total)
+{
+  stream->replay(sStream, size);
+  sPublishes = 0;
+
+  const uint64_t startTime = nanos();
+
+  while(stream->bytes() < total)
+  {
+    client->parseStream();
+  }
+
+  const uint64_t elapsed = nanos() - startTime;
+
+  printf("%-16s %8.2f MB/s %10u publishes\n", name,
+         static_cast<double>(stream->bytes()) * 1000.0 / elapsed,
+         static_cast<unsigned>(sPublishes));
+}
+
+int
+main(int argc, char *argv[])
+{
+  const uint64_t   total = ((argc > 1) ? strtoul(argv[1], NULL, 10) : 64)
+                           * 1000000ULL;
+  RMSNLocalGateway gateway;
+  ReplayStream     stream(&gateway);
+  RMSNClient       client;
+  char             topicName[] = "bench/decode";
+
+  rHostFreezeClock();
+  srand(1);
+  client.begin(&stream);
+  client.setClientId("decode");
+  client.received.connect(onReceived);
+
+  // Older trees return nothing from these, give the gateway time instead.
+  client.connect();
+  settle();
+  client.subscribeByName(topicName);
+  settle();
+  // Older trees only learn the topic id from a registration.
+  client.registerTopic(topicName);
+  settle();
+
+  const RMSNTopic *topic = client.getTopicByName(topicName);
+
+  if(!topic)
+  {
+    printf("Subscribe failed\n");
+    return 1;
+  }
+
+  run(&client, &stream, "large publishes",
+      fillPublishes(topic->id, RMSN_MAX_BUFFER_SIZE), total);
+  run(&client, &stream, "short publishes", fillPublishes(topic->id, 16),
+      total);
+
+  for(size_t i = 0; i < sizeof(sStream); ++i)
+  {
+    sStream[i] = static_cast<uint8_t>(rand());
+  }
+
+  run(&client, &stream, "noise", sizeof(sStream), total);
+
+  return 0;
+}
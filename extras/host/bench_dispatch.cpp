@@ -0,0 +1,248 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Cost of reading and dispatching one received frame.
+ *
+ * The client connects and subscribes through RMSNLocalGateway, then
+ * parseStream() runs over a fixed mix of frames replayed from memory: mostly
+ * publishes to the subscribed topic, the rest advertisements, gateway infos,
+ * unsolicited acknowledgements, a malformed and an unknown frame. Only the
+ * public API is used, so the same file builds against older trees for a
+ * comparison, see README.md.
+ *
+ *     bench_dispatch [frames]
+ */
+
+#include <RMqttSN.h>
+#include <RMSNLocalGateway.h>
+#include <RHost.h>
+#include <time.h>
+
+#define TOPIC_ID_MARK 0xFF
+
+/**
+ * @brief Writes to the gateway, reads from the gateway or, once replaying,
+ * from a buffer of frames over and over.
+ */
+class ReplayStream : public Stream
+{
+public:
+  ReplayStream(RMSNLocalGateway *gateway)
+    : mGateway(gateway), mFrames(NULL), mSize(0), mPos(0)
+  {
+  }
+
+  void
+  replay(const uint8_t *frames, size_t size)
+  {
+    mFrames = frames;
+    mSize   = size;
+    mPos    = 0;
+  }
+
+  int
+  available()
+  {
+    return mFrames ? static_cast<int>(mSize - mPos) : mGateway->available();
+  }
+
+  int
+  read()
+  {
+    if(!mFrames)
+    {
+      return mGateway->read();
+    }
+
+    const uint8_t c = mFrames[mPos];
+
+    if(++mPos >= mSize)
+    {
+      mPos = 0;
+    }
+
+    return c;
+  }
+
+  int
+  peek()
+  {
+    return mFrames ? mFrames[mPos] : mGateway->peek();
+  }
+
+  size_t
+  write(uint8_t c)
+  {
+    return mGateway->write(c);
+  }
+
+  size_t
+  write(const uint8_t *buffer, size_t size)
+  {
+    return mGateway->write(buffer, size);
+  }
+
+  void
+  flush()
+  {
+    mGateway->flush();
+  }
+
+private:
+  RMSNLocalGateway *mGateway;
+  const uint8_t    *mFrames;
+  size_t            mSize;
+  size_t            mPos;
+};
+
+/// Frames as they come off the wire, TOPIC_ID_MARK bytes are replaced by
+/// the subscribed topic id.
+static uint8_t sFrames[] = {
+  // PUBLISH, QoS 0, 16 bytes payload, four times
+  23, RMSNMT_PUBLISH, RMSN_FLAG_QOS_0, TOPIC_ID_MARK, TOPIC_ID_MARK, 0, 0,
+  '2', '1', '.', '5', ';', '4', '8', ';', '1', '0', '1', '3', ';', 'o', 'k',
+  ';',
+  23, RMSNMT_PUBLISH, RMSN_FLAG_QOS_0, TOPIC_ID_MARK, TOPIC_ID_MARK, 0, 0,
+  '2', '1', '.', '6', ';', '4', '8', ';', '1', '0', '1', '3', ';', 'o', 'k',
+  ';',
+  23, RMSNMT_PUBLISH, RMSN_FLAG_QOS_0, TOPIC_ID_MARK, TOPIC_ID_MARK, 0, 0,
+  '2', '1', '.', '6', ';', '4', '9', ';', '1', '0', '1', '2', ';', 'o', 'k',
+  ';',
+  23, RMSNMT_PUBLISH, RMSN_FLAG_QOS_0, TOPIC_ID_MARK, TOPIC_ID_MARK, 0, 0,
+  '2', '1', '.', '7', ';', '4', '9', ';', '1', '0', '1', '2', ';', 'o', 'k',
+  ';',
+  // ADVERTISE, 960 s
+  5, RMSNMT_ADVERTISE, 1, 0x03, 0xC0,
+  // GWINFO
+  3, RMSNMT_GWINFO, 1,
+  // PUBACK nobody waits for
+  7, RMSNMT_PUBACK, TOPIC_ID_MARK, TOPIC_ID_MARK, 0x12, 0x34, RMSNRC_ACCEPTED,
+  // PINGRESP nobody waits for
+  2, RMSNMT_PINGRESP,
+  // PINGRESP one byte too long
+  3, RMSNMT_PINGRESP, 0,
+  // A type outside the protocol
+  4, 0x30, 0, 0,
+};
+
+/// Frames in sFrames
+#define FRAME_COUNT     10
+/// Publishes in sFrames
+#define PUBLISH_COUNT   4
+
+static uint32_t sPublishes = 0;
+
+static void
+onReceived(const RMSNMsgHeader *msg)
+{
+  if(RMSNMT_PUBLISH == msg->type)
+  {
+    ++sPublishes;
+  }
+}
+
+static void
+settle()
+{
+  for(uint8_t i = 0; i < 100; ++i)
+  {
+    rHostAdvance(1);
+  }
+}
+
+static uint64_t
+nanos()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const uint32_t   rounds = ((argc > 1) ? strtoul(argv[1], NULL, 10)
+                             : 2000000UL) / FRAME_COUNT;
+  RMSNLocalGateway gateway;
+  ReplayStream     stream(&gateway);
+  RMSNClient       client;
+  char             topicName[] = "bench/dispatch";
+
+  rHostFreezeClock();
+  client.begin(&stream);
+  client.setClientId("dispatch");
+  client.received.connect(onReceived);
+
+  // Older trees return nothing from these, give the gateway time instead.
+  client.connect();
+  settle();
+  client.subscribeByName(topicName);
+  settle();
+  // Older trees only learn the topic id from a registration.
+  client.registerTopic(topicName);
+  settle();
+
+  const RMSNTopic *topic = client.getTopicByName(topicName);
+
+  if(!topic)
+  {
+    printf("Subscribe failed\n");
+    return 1;
+  }
+
+  for(size_t i = 0; i + 1 < sizeof(sFrames); ++i)
+  {
+    if((TOPIC_ID_MARK == sFrames[i]) && (TOPIC_ID_MARK == sFrames[i + 1]))
+    {
+      sFrames[i]     = static_cast<uint8_t>(topic->id >> 8);
+      sFrames[i + 1] = static_cast<uint8_t>(topic->id);
+    }
+  }
+
+  stream.replay(sFrames, sizeof(sFrames));
+  sPublishes = 0;
+
+  const uint64_t startTime = nanos();
+
+  for(uint32_t i = 0; i < rounds; ++i)
+  {
+    for(uint8_t j = 0; j < FRAME_COUNT; ++j)
+    {
+      client.parseStream();
+    }
+  }
+
+  const uint64_t elapsed = nanos() - startTime;
+  const uint32_t frames  = rounds * FRAME_COUNT;
+
+  printf("%u frames, %u publishes delivered, %.1f ns/frame, %.2f MB/s\n",
+         static_cast<unsigned>(frames), static_cast<unsigned>(sPublishes),
+         static_cast<double>(elapsed) / frames,
+         static_cast<double>(sizeof(sFrames)) * rounds * 1000.0 / elapsed);
+
+  return (rounds * PUBLISH_COUNT == sPublishes) ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Encode and decode cost of an RMSNSchema record against hand-written code.
+ *
+ * Three ways of putting the same record into a payload stream and back:
+ * the schema, hand-written code producing the same varint bytes, and the
+ * memcpy() of the whole struct that sketches do without a schema.
+ */
+
+#include <RMqttSN.h>
+#include <RMSNSchema.h>
+#include <RBufferStream.h>
+#include <time.h>
+
+#define SAMPLE_COUNT 256
+#define ROUNDS       4000
+
+struct Sample
+{
+  uint16_t id;
+  int16_t  temperature;
+  uint32_t pressure;
+  bool     hasPressure;
+  uint8_t  status;
+  int32_t  altitude;
+};
+
+typedef RMSNSchema<
+    RMSNField<Sample, uint16_t, &Sample::id>,
+    RMSNField<Sample, int16_t, &Sample::temperature, RMSNFE_ZIGZAG>,
+    RMSNOptionalField<Sample, uint32_t, &Sample::pressure,
+                      &Sample::hasPressure>,
+    RMSNField<Sample, uint8_t, &Sample::status, RMSNFE_FIXED>,
+    RMSNField<Sample, int32_t, &Sample::altitude, RMSNFE_ZIGZAG> >
+  SampleSchema;
+
+static Sample sSamples[SAMPLE_COUNT];
+static uint8_t sPayloads[SAMPLE_COUNT][RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish)];
+static uint8_t sLengths[SAMPLE_COUNT];
+
+static bool
+writeVarint(uint32_t value, Print *output)
+{
+  while(value >= 0x80)
+  {
+    if(output->write(static_cast<uint8_t>(value | 0x80)) != 1)
+    {
+      return false;
+    }
+
+    value >>= 7;
+  }
+
+  return output->write(static_cast<uint8_t>(value)) == 1;
+}
+
+static bool
+readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value)
+{
+  uint8_t shift = 0;
+
+  value = 0;
+
+  while(data < end)
+  {
+    const uint8_t c = *data++;
+
+    value |= static_cast<uint32_t>(c & 0x7F) << shift;
+
+    if(!(c & 0x80))
+    {
+      return true;
+    }
+
+    shift += 7;
+
+    if(shift > 28)
+    {
+      return false;
+    }
+  }
+
+  return false;
+}
+
+static bool
+encodeByHand(const Sample &sample, Print *output)
+{
+  return writeVarint(sample.hasPressure ? 1 : 0, output)
+         && writeVarint(sample.id, output)
+         && writeVarint(static_cast<uint16_t>((sample.temperature << 1)
+                                              ^ (sample.temperature >> 15)),
+                        output)
+         && (!sample.hasPressure || writeVarint(sample.pressure, output))
+         && (output->write(sample.status) == 1)
+         && writeVarint((static_cast<uint32_t>(sample.altitude) << 1)
+                        ^ static_cast<uint32_t>(sample.altitude >> 31),
+                        output);
+}
+
+static bool
+decodeByHand(Sample &sample, const uint8_t *data, const uint8_t length)
+{
+  const uint8_t *end = data + length;
+  uint32_t       value;
+
+  if(!readVarint(data, end, value))
+  {
+    return false;
+  }
+
+  sample.hasPressure = value & 1;
+
+  if(!readVarint(data, end, value) || (value > 0xFFFF))
+  {
+    return false;
+  }
+
+  sample.id = value;
+
+  if(!readVarint(data, end, value) || (value > 0xFFFF))
+  {
+    return false;
+  }
+
+  sample.temperature = (value >> 1) ^ -(value & 1);
+
+  if(sample.hasPressure && !readVarint(data, end, sample.pressure))
+  {
+    return false;
+  }
+
+  if(data >= end)
+  {
+    return false;
+  }
+
+  sample.status = *data++;
+
+  if(!readVarint(data, end, value))
+  {
+    return false;
+  }
+
+  sample.altitude = (value >> 1) ^ -(value & 1);
+
+  return true;
+}
+
+static bool
+encodeSchema(const Sample &sample, Print *output)
+{
+  return SampleSchema::encode(sample, output);
+}
+
+static bool
+decodeSchema(Sample &sample, const uint8_t *data, const uint8_t length)
+{
+  return SampleSchema::decode(sample, RMSNPayloadReader(data, length));
+}
+
+static bool
+encodeMemcpy(const Sample &sample, Print *output)
+{
+  return output->write(reinterpret_cast<const uint8_t *>(&sample),
+                       sizeof(sample)) == sizeof(sample);
+}
+
+static bool
+decodeMemcpy(Sample &sample, const uint8_t *data, const uint8_t length)
+{
+  if(length != sizeof(sample))
+  {
+    return false;
+  }
+
+  memcpy(&sample, data, sizeof(sample));
+
+  return true;
+}
+
+static uint64_t
+nowNanos()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static bool
+isSame(const Sample &a, const Sample &b)
+{
+  return (a.id == b.id) && (a.temperature == b.temperature)
+         && (a.hasPressure == b.hasPressure)
+         && (!a.hasPressure || (a.pressure == b.pressure))
+         && (a.status == b.status) && (a.altitude == b.altitude);
+}
+
+static bool
+run(const char *name, bool (*encode)(const Sample &, Print *),
+    bool (*decode)(Sample &, const uint8_t *, const uint8_t))
+{
+  RBufferStream stream;
+  uint32_t      bytes       = 0;
+  uint64_t      encodeNanos = 0;
+  uint64_t      decodeNanos = 0;
+
+  for(uint16_t round = 0; round < ROUNDS; ++round)
+  {
+    uint64_t startTime = nowNanos();
+
+    for(uint16_t i = 0; i < SAMPLE_COUNT; ++i)
+    {
+      stream.setBuffer(sPayloads[i], sizeof(sPayloads[i]));
+
+      if(!encode(sSamples[i], &stream))
+      {
+        return false;
+      }
+
+      sLengths[i] = stream.available();
+    }
+
+    encodeNanos += nowNanos() - startTime;
+    startTime    = nowNanos();
+
+    for(uint16_t i = 0; i < SAMPLE_COUNT; ++i)
+    {
+      Sample sample;
+
+      if(!decode(sample, sPayloads[i], sLengths[i])
+         || !isSame(sample, sSamples[i]))
+      {
+        return false;
+      }
+    }
+
+    decodeNanos += nowNanos() - startTime;
+  }
+
+  for(uint16_t i = 0; i < SAMPLE_COUNT; ++i)
+  {
+    bytes += sLengths[i];
+  }
+
+  printf("%-8s %8.1f %11.1f %11.1f\n", name,
+         static_cast<double>(bytes) / SAMPLE_COUNT,
+         static_cast<double>(encodeNanos) / ROUNDS / SAMPLE_COUNT,
+         static_cast<double>(decodeNanos) / ROUNDS / SAMPLE_COUNT);
+
+  return true;
+}
+
+int
+main()
+{
+  srand(1);
+
+  for(uint16_t i = 0; i < SAMPLE_COUNT; ++i)
+  {
+    Sample &sample = sSamples[i];
+
+    memset(&sample, 0, sizeof(sample));
+    sample.id          = i * 37;
+    sample.temperature = rand() % 8000 - 2000;
+    sample.hasPressure = (i % 4) != 0;
+    sample.pressure    = sample.hasPressure ? 95000 + rand() % 10000 : 0;
+    sample.status      = rand();
+    sample.altitude    = rand() % 20000 - 500;
+  }
+
+  printf("record   bytes/rec  encode_ns  decode_ns\n");
+
+  if(!run("schema", encodeSchema, decodeSchema)
+     || !run("by hand", encodeByHand, decodeByHand)
+     || !run("memcpy", encodeMemcpy, decodeMemcpy))
+  {
+    printf("round trip FAILED\n");
+    return 1;
+  }
+
+  return 0;
+}
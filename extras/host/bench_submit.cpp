@@ -0,0 +1,177 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Contention benchmark and stress test of RMSNSubmitQueue.
+ *
+ * 1 to 16 producer threads submit numbered publishes while one consumer
+ * thread drains them with front() and pop(). Each producer's numbers must
+ * come out complete and in order, or the run fails: a lost, duplicated or
+ * torn submission is reported. Producers retry when the queue is full.
+ *
+ *     bench_submit [submissions_per_producer]
+ *
+ * Needs -pthread.
+ */
+
+#include <RMSNSubmitQueue.h>
+#include <atomic>
+#include <thread>
+#include <time.h>
+
+#define MAX_PRODUCERS 16
+
+struct Record
+{
+  uint32_t producer;
+  uint32_t number;
+  /// Both again, to catch a torn copy
+  uint32_t check;
+};
+
+static RMSNSubmitQueue  *sQueue;
+static std::atomic<bool> sIsStarted;
+
+static void
+produce(const uint32_t producer, const uint32_t count)
+{
+  while(!sIsStarted.load())
+  {
+  }
+
+  for(uint32_t i = 0; i < count; ++i)
+  {
+    Record record = {producer, i, producer ^ i ^ 0xA5A5A5A5};
+
+    while(!sQueue->submit(static_cast<uint16_t>(producer), &record,
+                          sizeof(record), RMSN_FLAG_QOS_0))
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+/// @return Errors found
+static uint32_t
+consume(const uint8_t producers, const uint32_t count)
+{
+  uint32_t expected[MAX_PRODUCERS] = {0};
+  uint32_t remaining = producers * count;
+  uint32_t errors    = 0;
+
+  while(remaining > 0)
+  {
+    const RMSNSubmission *submission = sQueue->front();
+
+    if(!submission)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    Record record;
+
+    memcpy(&record, submission->data, sizeof(record));
+
+    if((submission->dataLen != sizeof(record))
+       || (record.producer >= producers)
+       || (submission->topicId != record.producer)
+       || (record.check != (record.producer ^ record.number ^ 0xA5A5A5A5)))
+    {
+      ++errors;
+    }
+    else if(record.number != expected[record.producer]++)
+    {
+      // Lost or duplicated, resynchronize.
+      ++errors;
+      expected[record.producer] = record.number + 1;
+    }
+
+    sQueue->pop();
+    --remaining;
+  }
+
+  return errors;
+}
+
+static uint64_t
+nanos()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const uint32_t count  = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+  const uint8_t  counts[] = {1, 2, 4, 8, 16};
+  uint32_t       failures = 0;
+
+  static_assert(sizeof(Record) <= RMSN_SUBMIT_DATA_SIZE,
+                "Record must fit into a submission");
+
+  printf("%u slots, %u submissions per producer, %u cores\n",
+         RMSN_SUBMIT_QUEUE_SIZE, static_cast<unsigned>(count),
+         std::thread::hardware_concurrency());
+  printf("producers  Msub/s  ns/sub  errors\n");
+
+  for(uint8_t i = 0; i < sizeof(counts); ++i)
+  {
+    const uint8_t   producers = counts[i];
+    RMSNSubmitQueue queue;
+    std::thread     threads[MAX_PRODUCERS];
+
+    sQueue = &queue;
+    sIsStarted.store(false);
+
+    for(uint8_t j = 0; j < producers; ++j)
+    {
+      threads[j] = std::thread(produce, j, count);
+    }
+
+    const uint64_t startTime = nanos();
+
+    sIsStarted.store(true);
+
+    const uint32_t errors  = consume(producers, count);
+    const uint64_t elapsed = nanos() - startTime;
+
+    for(uint8_t j = 0; j < producers; ++j)
+    {
+      threads[j].join();
+    }
+
+    failures += errors;
+    printf("%9u %7.2f %7.1f %7u\n", producers,
+           producers * count * 1000.0 / elapsed,
+           static_cast<double>(elapsed) / (producers * count),
+           static_cast<unsigned>(errors));
+  }
+
+  return failures ? 1 : 0;
+}
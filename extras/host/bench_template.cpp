@@ -0,0 +1,208 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * CPU time per QoS 0 publish, through an RMSNPublishTemplate and through
+ * publish(topicId, data, dataLen).
+ *
+ * The client connects and registers through RMSNLocalGateway, then the
+ * frames it sends go to a sink, so only the client's own work is measured.
+ *
+ *     bench_template [publishes]
+ */
+
+#include <RMqttSN.h>
+#include <RMSNLocalGateway.h>
+#include <RHost.h>
+#include <time.h>
+
+/**
+ * @brief Talks to the gateway until sinking, then drops what's written.
+ */
+class SinkStream : public Stream
+{
+public:
+  SinkStream(RMSNLocalGateway *gateway)
+    : mGateway(gateway), mIsSinking(false), mBytes(0)
+  {
+  }
+
+  void
+  sink()
+  {
+    mIsSinking = true;
+  }
+
+  uint32_t
+  takeBytes()
+  {
+    const uint32_t bytes = mBytes;
+
+    mBytes = 0;
+    return bytes;
+  }
+
+  int
+  available()
+  {
+    return mIsSinking ? 0 : mGateway->available();
+  }
+
+  int
+  read()
+  {
+    return mIsSinking ? -1 : mGateway->read();
+  }
+
+  int
+  peek()
+  {
+    return mIsSinking ? -1 : mGateway->peek();
+  }
+
+  size_t
+  write(uint8_t c)
+  {
+    return write(&c, 1);
+  }
+
+  size_t
+  write(const uint8_t *buffer, size_t size)
+  {
+    if(mIsSinking)
+    {
+      mBytes += size;
+      return size;
+    }
+
+    return mGateway->write(buffer, size);
+  }
+
+  void
+  flush()
+  {
+  }
+
+private:
+  RMSNLocalGateway *mGateway;
+  bool              mIsSinking;
+  uint32_t          mBytes;
+};
+
+static uint64_t
+cpuNanos()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static RMSNRequestResult
+waitFor(const RMSNRequest &request)
+{
+  for(uint16_t i = 0; (i < 1000) && !request.isDone(); ++i)
+  {
+    rHostAdvance(1);
+  }
+
+  return request.result();
+}
+
+int
+main(int argc, char *argv[])
+{
+  const uint32_t   count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 5000000;
+  RMSNLocalGateway gateway;
+  SinkStream       stream(&gateway);
+  RMSNClient       client;
+  char             topicName[] = "bench/template";
+  uint8_t          payload[16];
+
+  rHostFreezeClock();
+  memset(payload, 0x5A, sizeof(payload));
+  client.begin(&stream);
+  client.setClientId("template");
+
+  if((RMSNRR_ACCEPTED != waitFor(client.connect()))
+     || (RMSNRR_ACCEPTED != waitFor(client.registerTopic(topicName))))
+  {
+    printf("Connect failed\n");
+    return 1;
+  }
+
+  const uint16_t            topicId   = client.getTopicByName(topicName)->id;
+  const RMSNPublishTemplate telemetry =
+    client.publishTemplate(topicId, RMSN_FLAG_QOS_0);
+
+  client.setQos(RMSN_FLAG_QOS_0);
+  stream.sink();
+
+  printf("%u publishes of %u bytes at QoS 0\n", static_cast<unsigned>(count),
+         static_cast<unsigned>(sizeof(payload)));
+  printf("%-18s %7s %9s\n", "path", "ns/pub", "bytes/pub");
+
+  // Best of three alternating rounds, the host is noisy.
+  double best[2] = {0, 0};
+
+  for(uint8_t round = 0; round < 6; ++round)
+  {
+    const uint8_t  path      = round % 2;
+    uint32_t       published = 0;
+    const uint64_t startTime = cpuNanos();
+
+    for(uint32_t i = 0; i < count; ++i)
+    {
+      payload[0] = static_cast<uint8_t>(i);
+
+      const RMSNRequest request =
+        path ? client.publish(topicId, payload, sizeof(payload))
+        : client.publish(telemetry, payload, sizeof(payload));
+
+      published += request ? 1 : 0;
+    }
+
+    const double elapsed = static_cast<double>(cpuNanos() - startTime);
+
+    if((0 == best[path]) || (elapsed / count < best[path]))
+    {
+      best[path] = elapsed / count;
+    }
+
+    if(published != count)
+    {
+      printf("Only %u published\n", static_cast<unsigned>(published));
+      return 1;
+    }
+  }
+
+  // Both paths send the same frames.
+  const double bytes = static_cast<double>(stream.takeBytes()) / (6.0 * count);
+
+  printf("%-18s %7.1f %9.1f\n", "template", best[0], bytes);
+  printf("%-18s %7.1f %9.1f\n", "publish(topicId)", best[1], bytes);
+
+  return 0;
+}
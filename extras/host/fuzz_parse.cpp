@@ -0,0 +1,263 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+/**
+ * Fuzz target for the receive path.
+ *
+ * The first input byte picks the state the client is in: fresh, connected
+ * with a subscription, or waiting for the response to a connect, a QoS 1
+ * publish or a registration. The rest is the byte stream coming from the
+ * gateway, read by parseStream() from the idle loop as on a board.
+ *
+ * With -DRMSN_FUZZ_LIBFUZZER only LLVMFuzzerTestOneInput() is defined, for
+ * libFuzzer. Otherwise main() runs each file given, or stdin, once, for AFL
+ * and for replaying a crash. See README.md for the builds.
+ */
+
+#include <RMqttSN.h>
+#include <RMSNLocalGateway.h>
+#include <RHost.h>
+
+/**
+ * @brief Writes to the gateway, reads from the gateway until the fuzz input
+ * is fed, then from the input only.
+ */
+class FuzzStream : public Stream
+{
+public:
+  FuzzStream(RMSNLocalGateway *gateway)
+    : mGateway(gateway), mData(NULL), mSize(0), mPos(0), mIsFed(false)
+  {
+  }
+
+  void
+  feed(const uint8_t *data, size_t size)
+  {
+    mData  = data;
+    mSize  = size;
+    mPos   = 0;
+    mIsFed = true;
+  }
+
+  bool
+  atEnd() const
+  {
+    return mPos >= mSize;
+  }
+
+  int
+  available()
+  {
+    if(!mIsFed)
+    {
+      return mGateway->available();
+    }
+
+    if(atEnd())
+    {
+      // The client may wait for the rest of a frame, let time pass.
+      rHostElapse(1);
+      return 0;
+    }
+
+    return static_cast<int>(mSize - mPos);
+  }
+
+  int
+  read()
+  {
+    if(!mIsFed)
+    {
+      return mGateway->read();
+    }
+
+    return atEnd() ? -1 : mData[mPos++];
+  }
+
+  int
+  peek()
+  {
+    if(!mIsFed)
+    {
+      return mGateway->peek();
+    }
+
+    return atEnd() ? -1 : mData[mPos];
+  }
+
+  size_t
+  write(uint8_t c)
+  {
+    return mGateway->write(c);
+  }
+
+  size_t
+  write(const uint8_t *buffer, size_t size)
+  {
+    return mGateway->write(buffer, size);
+  }
+
+  void
+  flush()
+  {
+  }
+
+private:
+  RMSNLocalGateway *mGateway;
+  const uint8_t    *mData;
+  size_t            mSize;
+  size_t            mPos;
+  bool              mIsFed;
+};
+
+enum FuzzState
+{
+  FS_FRESH = 0,
+  FS_CONNECTING,
+  FS_SUBSCRIBED,
+  FS_PUBLISHING,
+  FS_REGISTERING,
+  FS_COUNT,
+};
+
+static volatile uint8_t sChecksum = 0;
+
+static void
+onReceived(const RMSNMsgHeader *msg)
+{
+  // Touch every byte the client claims is there, for the sanitizers.
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(msg);
+
+  for(uint8_t i = 0; i < msg->length; ++i)
+  {
+    sChecksum += bytes[i];
+  }
+}
+
+static void
+settle()
+{
+  for(uint8_t i = 0; i < 20; ++i)
+  {
+    rHostAdvance(1);
+  }
+}
+
+extern "C" int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  if(size < 1)
+  {
+    return 0;
+  }
+
+  static bool isFrozen = false;
+
+  if(!isFrozen)
+  {
+    rHostFreezeClock();
+    isFrozen = true;
+  }
+
+  RMSNLocalGateway gateway;
+  FuzzStream       stream(&gateway);
+  RMSNClient       client;
+  const uint8_t    state   = data[0] % FS_COUNT;
+  const uint8_t    payload[] = {1, 2, 3, 4};
+
+  client.begin(&stream);
+  client.setClientId("fuzz");
+  client.received.connect(onReceived);
+
+  if(state != FS_FRESH)
+  {
+    client.connect();
+
+    if(state != FS_CONNECTING)
+    {
+      settle();
+      client.setQos(RMSN_FLAG_QOS_1);
+      client.subscribeByName("fuzz/in");
+      settle();
+    }
+
+    if(FS_PUBLISHING == state)
+    {
+      client.publish(1, payload, sizeof(payload));
+    }
+    else if(FS_REGISTERING == state)
+    {
+      client.registerTopic("fuzz/out");
+    }
+  }
+
+  stream.feed(data + 1, size - 1);
+
+  // One frame per idle loop, timers firing in between as on a board.
+  while(!stream.atEnd())
+  {
+    rHostAdvance(1);
+  }
+
+  return 0;
+}
+
+#ifndef RMSN_FUZZ_LIBFUZZER
+
+static int
+runFile(FILE *file)
+{
+  static uint8_t buffer[65536];
+
+  const size_t size = fread(buffer, 1, sizeof(buffer), file);
+
+  return LLVMFuzzerTestOneInput(buffer, size);
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc < 2)
+  {
+    return runFile(stdin);
+  }
+
+  for(int i = 1; i < argc; ++i)
+  {
+    FILE *file = fopen(argv[i], "rb");
+
+    if(!file)
+    {
+      perror(argv[i]);
+      return 1;
+    }
+
+    runFile(file);
+    fclose(file);
+  }
+
+  return 0;
+}
+
+#endif // RMSN_FUZZ_LIBFUZZER
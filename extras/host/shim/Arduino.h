@@ -0,0 +1,89 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#ifndef __INCLUDED_4B6AB4144B0C11E7AA6EA088B4D1658C
+#define __INCLUDED_4B6AB4144B0C11E7AA6EA088B4D1658C
+
+/**
+ * Host stand-ins for the parts of the Arduino core the library uses, so its
+ * sources build and run on a PC for tests, fuzzing and benchmarks. Nothing
+ * here allocates.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define F(string) (string)
+#define pgm_read_byte(address) (*reinterpret_cast<const uint8_t *>(address))
+#define pgm_read_word(address) (*reinterpret_cast<const uint16_t *>(address))
+#define memcpy_P memcpy
+
+/// Milliseconds of a steady clock plus the offset of rHostAdvance().
+unsigned long
+millis();
+unsigned long
+micros();
+long
+random(long howBig);
+long
+random(long howSmall, long howBig);
+void
+randomSeed(unsigned long seed);
+
+class Print
+{
+public:
+  virtual
+  ~Print() {}
+
+  virtual size_t
+  write(uint8_t c) = 0;
+  virtual size_t
+  write(const uint8_t *buffer, size_t size);
+  size_t
+  write(const char *text)
+  {
+    return write(reinterpret_cast<const uint8_t *>(text), strlen(text));
+  }
+
+  virtual void
+  flush() {}
+};
+
+class Stream : public Print
+{
+public:
+  virtual int
+  available() = 0;
+  virtual int
+  read() = 0;
+  virtual int
+  peek() = 0;
+};
+
+#endif // __INCLUDED_4B6AB4144B0C11E7AA6EA088B4D1658C
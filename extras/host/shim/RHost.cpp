@@ -0,0 +1,301 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include <RBufferStream.h>
+#include <RCoreApplication.h>
+#include <RHost.h>
+#include <RTimer.h>
+#include <time.h>
+
+static unsigned long    sClockOffset = 0;
+/// Steady clock reading the clock stays at, 0 while following it
+static unsigned long    sFrozenTime  = 0;
+static RSignalBase     *sSignals     = NULL;
+static RTimer          *sTimers      = NULL;
+static REventLoop       sEventLoop;
+static RThread          sThread;
+static RCoreApplication sApplication;
+
+RCoreApplication *rCoreApp = &sApplication;
+
+static unsigned long
+clockMicros()
+{
+  if(sFrozenTime)
+  {
+    return sFrozenTime;
+  }
+
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return static_cast<unsigned long>(now.tv_sec) * 1000000UL
+         + static_cast<unsigned long>(now.tv_nsec / 1000);
+}
+
+unsigned long
+millis()
+{
+  return clockMicros() / 1000 + sClockOffset;
+}
+
+unsigned long
+micros()
+{
+  return clockMicros() + sClockOffset * 1000;
+}
+
+long
+random(long howBig)
+{
+  return (howBig > 0) ? (rand() % howBig) : 0;
+}
+
+long
+random(long howSmall, long howBig)
+{
+  return (howBig > howSmall) ? (howSmall + random(howBig - howSmall))
+         : howSmall;
+}
+
+void
+randomSeed(unsigned long seed)
+{
+  srand(static_cast<unsigned int>(seed));
+}
+
+void
+rHostFreezeClock()
+{
+  sFrozenTime = clockMicros();
+}
+
+void
+rHostAdvance(const uint32_t milliseconds)
+{
+  rHostElapse(milliseconds);
+  rHostProcessEvents();
+}
+
+void
+rHostElapse(const uint32_t milliseconds)
+{
+  sClockOffset += milliseconds;
+}
+
+void
+rHostProcessEvents()
+{
+  RTimer::processAll();
+  sEventLoop.idle.emit();
+}
+
+size_t
+Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t written = 0;
+
+  while(size--)
+  {
+    written += write(*buffer++);
+  }
+
+  return written;
+}
+
+RObject::~RObject()
+{
+  RSignalBase::disconnectAll(this);
+}
+
+RSignalBase::RSignalBase() : mNext(sSignals)
+{
+  sSignals = this;
+}
+
+RSignalBase::~RSignalBase()
+{
+  for(RSignalBase **link = &sSignals; *link; link = &(*link)->mNext)
+  {
+    if(*link == this)
+    {
+      *link = mNext;
+      break;
+    }
+  }
+}
+
+void
+RSignalBase::disconnectAll(const RObject *receiver)
+{
+  for(RSignalBase *signal = sSignals; signal; signal = signal->mNext)
+  {
+    signal->disconnect(receiver);
+  }
+}
+
+REventLoop *
+RThread::eventLoop()
+{
+  return &sEventLoop;
+}
+
+RThread *
+RCoreApplication::thread()
+{
+  return &sThread;
+}
+
+RTimer::RTimer()
+  : mIsSingleShot(false), mIsActive(false), mInterval(0), mStartTime(0),
+  mNext(sTimers)
+{
+  sTimers = this;
+}
+
+RTimer::~RTimer()
+{
+  for(RTimer **link = &sTimers; *link; link = &(*link)->mNext)
+  {
+    if(*link == this)
+    {
+      *link = mNext;
+      break;
+    }
+  }
+}
+
+void
+RTimer::setSingleShot(bool isSingleShot)
+{
+  mIsSingleShot = isSingleShot;
+}
+
+void
+RTimer::setInterval(int32_t interval)
+{
+  mInterval = interval;
+}
+
+void
+RTimer::start()
+{
+  mIsActive  = true;
+  mStartTime = millis();
+}
+
+void
+RTimer::stop()
+{
+  mIsActive = false;
+}
+
+bool
+RTimer::isActive() const
+{
+  return mIsActive;
+}
+
+void
+RTimer::processAll()
+{
+  for(RTimer *timer = sTimers; timer; timer = timer->mNext)
+  {
+    if(!timer->mIsActive
+       || (millis() - timer->mStartTime
+           < static_cast<unsigned long>(timer->mInterval)))
+    {
+      continue;
+    }
+
+    // A repeating timer that fell behind catches up one interval a time.
+    timer->mStartTime += timer->mInterval;
+
+    if(timer->mIsSingleShot)
+    {
+      timer->mIsActive = false;
+    }
+
+    timer->timeout.emit();
+  }
+}
+
+RBufferStream::RBufferStream()
+  : mBuffer(NULL), mSize(0), mReadPos(0), mWritePos(0)
+{
+}
+
+RBufferStream::RBufferStream(uint8_t *buffer, size_t size)
+  : mBuffer(buffer), mSize(size), mReadPos(0), mWritePos(0)
+{
+}
+
+void
+RBufferStream::setBuffer(uint8_t *buffer, size_t size)
+{
+  mBuffer   = buffer;
+  mSize     = size;
+  mReadPos  = 0;
+  mWritePos = 0;
+}
+
+void
+RBufferStream::reset()
+{
+  mReadPos  = 0;
+  mWritePos = 0;
+}
+
+int
+RBufferStream::available()
+{
+  return static_cast<int>(mWritePos - mReadPos);
+}
+
+int
+RBufferStream::read()
+{
+  return (mReadPos < mWritePos) ? mBuffer[mReadPos++] : -1;
+}
+
+int
+RBufferStream::peek()
+{
+  return (mReadPos < mWritePos) ? mBuffer[mReadPos] : -1;
+}
+
+size_t
+RBufferStream::write(uint8_t c)
+{
+  if(mWritePos >= mSize)
+  {
+    return 0;
+  }
+
+  mBuffer[mWritePos++] = c;
+
+  return 1;
+}
@@ -0,0 +1,48 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#ifndef __INCLUDED_17B28A6EF50011E7AA6EA088B4D1658C
+#define __INCLUDED_17B28A6EF50011E7AA6EA088B4D1658C
+
+/**
+ * Controls of the host stand-ins that a sketch would not have.
+ */
+
+#include <stdint.h>
+
+/// Stop following the steady clock, from now on millis() and micros() only
+/// move with rHostAdvance(), so simulated runs are repeatable.
+void
+rHostFreezeClock();
+/// Move the clock forward without waiting, then process events.
+void
+rHostAdvance(const uint32_t milliseconds);
+/// Move the clock forward only, as time passing inside a busy loop.
+void
+rHostElapse(const uint32_t milliseconds);
+/// Fire due timers, then emit the idle signal of the event loop once.
+void
+rHostProcessEvents();
+
+#endif // __INCLUDED_17B28A6EF50011E7AA6EA088B4D1658C
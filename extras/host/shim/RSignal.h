@@ -0,0 +1,153 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#ifndef __INCLUDED_E9B5CC73623A11E7AA6EA088B4D1658C
+#define __INCLUDED_E9B5CC73623A11E7AA6EA088B4D1658C
+
+#include <stdlib.h>
+#include <type_traits>
+#include "RObject.h"
+
+/// Slots a signal could call
+#define RHOST_SIGNAL_SLOTS 8
+
+/**
+ * @brief Signals live in one list, so that a destroyed RObject is
+ * disconnected from all of them.
+ */
+class RSignalBase
+{
+public:
+  RSignalBase();
+  virtual
+  ~RSignalBase();
+
+  static void
+  disconnectAll(const RObject *receiver);
+
+protected:
+  virtual void
+  disconnect(const RObject *receiver) = 0;
+
+private:
+  RSignalBase *mNext;
+};
+
+template <class Signature>
+class RSignal;
+
+template <class R, class ... Args>
+class RSignal<R(Args ...)> : public RSignalBase
+{
+public:
+  RSignal() : mCount(0) {}
+
+  void
+  connect(R (*function)(Args ...))
+  {
+    add(NULL, reinterpret_cast<void *>(function), callFunction);
+  }
+
+  template <class Receiver, R(Receiver::*method)(Args ...)>
+  void
+  connect(Receiver *receiver)
+  {
+    add(receiver, receiver, callMethod<Receiver, method>);
+  }
+
+  void
+  emit(Args ... args)
+  {
+    for(uint8_t i = 0; i < mCount; ++i)
+    {
+      mSlots[i].call(mSlots[i].target, args ...);
+    }
+  }
+
+protected:
+  void
+  disconnect(const RObject *receiver)
+  {
+    uint8_t kept = 0;
+
+    for(uint8_t i = 0; i < mCount; ++i)
+    {
+      if(mSlots[i].receiver != receiver)
+      {
+        mSlots[kept++] = mSlots[i];
+      }
+    }
+
+    mCount = kept;
+  }
+
+private:
+  typedef R (*Call)(void *target, Args ... args);
+
+  struct Slot
+  {
+    const RObject *receiver;
+    void          *target;
+    Call           call;
+  };
+
+  void
+  add(const RObject *receiver, void *target, Call call)
+  {
+    if(mCount >= RHOST_SIGNAL_SLOTS)
+    {
+      // A harness connecting this much is broken, not short of room.
+      abort();
+    }
+
+    mSlots[mCount].receiver = receiver;
+    mSlots[mCount].target   = target;
+    mSlots[mCount].call     = call;
+    ++mCount;
+  }
+
+  static R
+  callFunction(void *target, Args ... args)
+  {
+    return reinterpret_cast<R (*)(Args ...)>(target)(args ...);
+  }
+
+  template <class Receiver, R(Receiver::*method)(Args ...)>
+  static R
+  callMethod(void *target, Args ... args)
+  {
+    return (static_cast<Receiver *>(target)->*method)(args ...);
+  }
+
+private:
+  Slot    mSlots[RHOST_SIGNAL_SLOTS];
+  uint8_t mCount;
+};
+
+#define R_CONNECT(sender, signal, receiver, method) \
+  (sender)->signal.template connect< \
+    std::remove_pointer<decltype(receiver)>::type, \
+    &std::remove_pointer<decltype(receiver)>::type::method>(receiver)
+
+#endif // __INCLUDED_E9B5CC73623A11E7AA6EA088B4D1658C
@@ -0,0 +1,64 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#ifndef __INCLUDED_5786BE66824611E7AA6EA088B4D1658C
+#define __INCLUDED_5786BE66824611E7AA6EA088B4D1658C
+
+#include "RSignal.h"
+
+/**
+ * @brief Timers fire from rHostProcessEvents() once their interval passed.
+ */
+class RTimer : public RObject
+{
+public:
+  RTimer();
+  ~RTimer();
+
+  void
+  setSingleShot(bool isSingleShot);
+  void
+  setInterval(int32_t interval);
+  void
+  start();
+  void
+  stop();
+  bool
+  isActive() const;
+
+  RSignal<void()> timeout;
+
+  /// Fire every active timer that is due.
+  static void
+  processAll();
+
+private:
+  bool          mIsSingleShot;
+  bool          mIsActive;
+  int32_t       mInterval;
+  unsigned long mStartTime;
+  RTimer       *mNext;
+};
+
+#endif // __INCLUDED_5786BE66824611E7AA6EA088B4D1658C
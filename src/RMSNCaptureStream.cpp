@@ -0,0 +1,205 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include "RMSNCaptureStream.h"
+
+RMSNCaptureFrame::RMSNCaptureFrame() : mLength(0), mReceived(0)
+{
+}
+
+bool
+RMSNCaptureFrame::push(const uint8_t c)
+{
+  if(mReceived < sizeof(mData))
+  {
+    mData[mReceived] = c;
+  }
+
+  ++mReceived;
+
+  if(1 == mReceived)
+  {
+    if(RMSN_EXTENDED_LENGTH != c)
+    {
+      // A zero length is a single byte the client reads and drops.
+      mLength = (c > 0) ? c : 1;
+    }
+  }
+  else if((3 == mReceived) && (0 == mLength))
+  {
+    mLength = (static_cast<uint16_t>(mData[1]) << 8) | mData[2];
+
+    if(mLength < 3)
+    {
+      mLength = 3;
+    }
+  }
+
+  return (mLength > 0) && (mReceived >= mLength);
+}
+
+void
+RMSNCaptureFrame::reset()
+{
+  mLength   = 0;
+  mReceived = 0;
+}
+
+const uint8_t *
+RMSNCaptureFrame::data() const
+{
+  return mData;
+}
+
+uint16_t
+RMSNCaptureFrame::length() const
+{
+  return mLength;
+}
+
+bool
+RMSNCaptureFrame::isComplete() const
+{
+  return (mLength > 0) && (mReceived >= mLength) &&
+         (mLength <= sizeof(mData));
+}
+
+RMSNCaptureStream::RMSNCaptureStream(Stream *transport, Print *capture)
+  : mTransport(transport)
+  , mCapture(capture)
+  , mIsStarted(false)
+  , mFramesCaptured(0)
+  , mFramesSkipped(0)
+{
+}
+
+int
+RMSNCaptureStream::available()
+{
+  return mTransport->available();
+}
+
+int
+RMSNCaptureStream::read()
+{
+  int c = mTransport->read();
+
+  if(c >= 0)
+  {
+    push(mRxFrame, RMSNCD_RX, static_cast<uint8_t>(c));
+  }
+
+  return c;
+}
+
+int
+RMSNCaptureStream::peek()
+{
+  return mTransport->peek();
+}
+
+size_t
+RMSNCaptureStream::write(uint8_t c)
+{
+  push(mTxFrame, RMSNCD_TX, c);
+
+  return mTransport->write(c);
+}
+
+size_t
+RMSNCaptureStream::write(const uint8_t *buffer, size_t size)
+{
+  for(size_t i = 0; i < size; ++i)
+  {
+    push(mTxFrame, RMSNCD_TX, buffer[i]);
+  }
+
+  return mTransport->write(buffer, size);
+}
+
+void
+RMSNCaptureStream::flush()
+{
+  mTransport->flush();
+}
+
+uint16_t
+RMSNCaptureStream::framesCaptured() const
+{
+  return mFramesCaptured;
+}
+
+uint16_t
+RMSNCaptureStream::framesSkipped() const
+{
+  return mFramesSkipped;
+}
+
+void
+RMSNCaptureStream::push(RMSNCaptureFrame &frame,
+                        const RMSNCaptureDirection direction, const uint8_t c)
+{
+  if(!frame.push(c))
+  {
+    return;
+  }
+
+  if(frame.isComplete())
+  {
+    record(frame, direction);
+  }
+  else
+  {
+    ++mFramesSkipped;
+  }
+
+  frame.reset();
+}
+
+void
+RMSNCaptureStream::record(const RMSNCaptureFrame &frame,
+                          const RMSNCaptureDirection direction)
+{
+  if(!mIsStarted)
+  {
+    mCapture->write(reinterpret_cast<const uint8_t *>(RMSN_CAPTURE_MAGIC),
+                    sizeof(RMSN_CAPTURE_MAGIC) - 1);
+    mIsStarted = true;
+  }
+
+  uint32_t timestamp = millis();
+
+  for(uint8_t i = 0; i < 4; ++i)
+  {
+    mCapture->write(static_cast<uint8_t>(timestamp));
+    timestamp >>= 8;
+  }
+
+  mCapture->write(static_cast<uint8_t>(direction));
+  mCapture->write(frame.data(), frame.length());
+
+  ++mFramesCaptured;
+}
@@ -0,0 +1,138 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_31C9EAD6E58A11E7AA6EA088B4D1658C
+#define __INCLUDED_31C9EAD6E58A11E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+#include "RMSNClient.h"
+
+/// Capture header, followed by the records
+#define RMSN_CAPTURE_MAGIC "RCP1"
+
+/**
+ * Direction of a captured frame, as seen from the client.
+ */
+enum RMSNCaptureDirection
+{
+  RMSNCD_RX,
+  RMSNCD_TX,
+} RMSN_STRUCT_PACKED;
+
+/**
+ * @brief Reassembles frames from a byte stream
+ *
+ * Frames longer than the buffer are still delimited, but only their first
+ * RMSN_MAX_BUFFER_SIZE bytes are kept.
+ */
+class RMSNCaptureFrame
+{
+public:
+  RMSNCaptureFrame();
+
+  /// Append a byte, true if it completed the frame.
+  bool
+  push(const uint8_t c);
+  /// Drop the frame, for starting the next one.
+  void
+  reset();
+
+  const uint8_t *
+  data() const;
+  uint16_t
+  length() const;
+  /// The whole completed frame fits in data()
+  bool
+  isComplete() const;
+
+private:
+  uint8_t  mData[RMSN_MAX_BUFFER_SIZE];
+  /// Zero until known
+  uint16_t mLength;
+  uint16_t mReceived;
+};
+
+/**
+ * @brief A Stream that records all frames passing through it
+ *
+ * It sits between the client and its transport and writes every frame read
+ * or written by the client to the capture output, which could be a SD card
+ * file or a spare serial port:
+ *
+ * @code
+ * RMSNCaptureStream capture(&Serial, &captureFile);
+ *
+ * client.begin(&capture);
+ * @endcode
+ *
+ * The capture starts with RMSN_CAPTURE_MAGIC, then each frame is recorded
+ * as its millis() timestamp (4 bytes, little endian), its
+ * RMSNCaptureDirection (1 byte) and its bytes as sent on the wire, which
+ * carry their own length. Frames too large for RMSN_MAX_BUFFER_SIZE are
+ * not recorded, they're counted by framesSkipped().
+ *
+ * Replay a capture with RMSNReplayStream.
+ */
+class RMSNCaptureStream : public Stream
+{
+public:
+  RMSNCaptureStream(Stream *transport, Print *capture);
+
+  int
+  available();
+  int
+  read();
+  int
+  peek();
+  size_t
+  write(uint8_t c);
+  size_t
+  write(const uint8_t *buffer, size_t size);
+  void
+  flush();
+
+  uint16_t
+  framesCaptured() const;
+  uint16_t
+  framesSkipped() const;
+
+private:
+  void
+  push(RMSNCaptureFrame &frame, const RMSNCaptureDirection direction,
+       const uint8_t c);
+  void
+  record(const RMSNCaptureFrame &frame, const RMSNCaptureDirection direction);
+
+private:
+  Stream          *mTransport;
+  Print           *mCapture;
+  bool             mIsStarted;
+  RMSNCaptureFrame mRxFrame;
+  RMSNCaptureFrame mTxFrame;
+  uint16_t         mFramesCaptured;
+  uint16_t         mFramesSkipped;
+};
+
+#endif // __INCLUDED_31C9EAD6E58A11E7AA6EA088B4D1658C
@@ -0,0 +1,301 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include <RByteOrder.h>
+#include "RMSNChunk.h"
+#include "RMSNClient.h"
+
+RMSNChunkPublisher::RMSNChunkPublisher(RMSNClient *client) :
+  mClient(client),
+  mData(NULL),
+  mSize(0),
+  mSent(0),
+  mTopicId(RMSN_INVALID_TOPIC_ID),
+  mChunkSize(0),
+  mSequence(0),
+  mIsFailed(false),
+  mLastChunkSize(0),
+  mRetries(0),
+  mRetryTime(0)
+{
+}
+
+void
+RMSNChunkPublisher::begin(const uint16_t topicId, const void *data,
+                          const uint16_t size, const uint8_t chunkSize)
+{
+  // The first chunk also carries the total size.
+  const uint8_t maxChunkSize = RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish)
+                               - sizeof(RMSNChunkHeader) - sizeof(uint16_t);
+
+  mData      = reinterpret_cast<const uint8_t *>(data);
+  mSize      = size;
+  mSent      = 0;
+  mTopicId   = topicId;
+  mChunkSize = ((0 == chunkSize) || (chunkSize > maxChunkSize)) ?
+               maxChunkSize : chunkSize;
+  mSequence = 0;
+  mIsFailed = false;
+  mRequest  = RMSNRequest();
+  mRetries  = 0;
+}
+
+bool
+RMSNChunkPublisher::process()
+{
+  if(NULL == mData)
+  {
+    return false;
+  }
+
+  // Nothing to wait for before the first chunk and while a rejected chunk
+  // waits to be sent again.
+  if(mRequest)
+  {
+    if(!mRequest.isDone())
+    {
+      return true;
+    }
+
+    const RMSNRequestResult result = mRequest.result();
+
+    if(RMSNRR_REJECTED_CONGESTION == result)
+    {
+      if(mRetries >= RMSN_N_RETRY)
+      {
+        mIsFailed = true;
+        mData     = NULL;
+        return false;
+      }
+
+      // Take the chunk back, it's sent again once the delay passed.
+      ++mRetries;
+      --mSequence;
+      mSent     -= mLastChunkSize;
+      mRetryTime = millis();
+      mRequest   = RMSNRequest();
+      return true;
+    }
+
+    if(RMSNRR_ACCEPTED != result)
+    {
+      mIsFailed = true;
+      mData     = NULL;
+      return false;
+    }
+
+    mRetries = 0;
+
+    if(mSent >= mSize)
+    {
+      // Last chunk is done.
+      mData = NULL;
+      return false;
+    }
+  }
+
+  if((mRetries > 0) && (millis() - mRetryTime < RMSN_CHUNK_RETRY_DELAY))
+  {
+    return true;
+  }
+
+  RMSNPublisher publisher = mClient->publish(mTopicId);
+
+  if(!publisher.isValid())
+  {
+    // No free publish frame, try again on the next call.
+    return true;
+  }
+
+  RMSNChunkHeader header;
+  uint16_t        chunkSize = mSize - mSent;
+
+  if(chunkSize > mChunkSize)
+  {
+    chunkSize = mChunkSize;
+  }
+
+  header.flags    = 0;
+  header.sequence = mSequence++;
+
+  if(0 == mSent)
+  {
+    header.flags |= RMSN_CHUNK_FLAG_FIRST;
+  }
+
+  if(mSent + chunkSize >= mSize)
+  {
+    header.flags |= RMSN_CHUNK_FLAG_LAST;
+  }
+
+  RBufferStream *stream = publisher.payloadStream();
+
+  stream->write(reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+
+  if(header.flags & RMSN_CHUNK_FLAG_FIRST)
+  {
+    stream->write(static_cast<uint8_t>(mSize >> 8));
+    stream->write(static_cast<uint8_t>(mSize));
+  }
+
+  stream->write(mData + mSent, chunkSize);
+
+  mSent         += chunkSize;
+  mLastChunkSize = static_cast<uint8_t>(chunkSize);
+  mRequest       = publisher.request();
+
+  return true;
+}
+
+bool
+RMSNChunkPublisher::isFinished() const
+{
+  return (NULL == mData) && !mIsFailed;
+}
+
+bool
+RMSNChunkPublisher::isFailed() const
+{
+  return mIsFailed;
+}
+
+uint16_t
+RMSNChunkPublisher::sent() const
+{
+  return mSent;
+}
+
+RMSNChunkAssembler::RMSNChunkAssembler(uint8_t *arena,
+                                       const uint16_t arenaSize) :
+  mArena(arena),
+  mArenaSize(arenaSize)
+{
+  reset();
+}
+
+RMSNChunkResult
+RMSNChunkAssembler::feed(const RMSNMsgPublish *msg)
+{
+  const uint8_t *payload    = reinterpret_cast<const uint8_t *>(msg->data);
+  uint8_t        payloadLen = 0;
+
+  if(msg->length > sizeof(RMSNMsgPublish))
+  {
+    payloadLen = msg->length - sizeof(RMSNMsgPublish);
+  }
+
+  if(payloadLen < sizeof(RMSNChunkHeader))
+  {
+    reset();
+    return RMSNCR_ERROR;
+  }
+
+  const RMSNChunkHeader *header =
+    reinterpret_cast<const RMSNChunkHeader *>(payload);
+  const uint16_t topicId = rNtohs(msg->topicId);
+
+  payload    += sizeof(RMSNChunkHeader);
+  payloadLen -= sizeof(RMSNChunkHeader);
+
+  if(header->flags & RMSN_CHUNK_FLAG_FIRST)
+  {
+    if(payloadLen < sizeof(uint16_t))
+    {
+      reset();
+      return RMSNCR_ERROR;
+    }
+
+    // A new first chunk restarts the assembly, even if the previous one is
+    // unfinished.
+    mSize       = (static_cast<uint16_t>(payload[0]) << 8) | payload[1];
+    mReceived   = 0;
+    mTopicId    = topicId;
+    mSequence   = header->sequence;
+    mIsStarted  = true;
+    payload    += sizeof(uint16_t);
+    payloadLen -= sizeof(uint16_t);
+
+    if(mSize > mArenaSize)
+    {
+      reset();
+      return RMSNCR_ERROR;
+    }
+  }
+  else if((!mIsStarted)
+          || (topicId != mTopicId)
+          || (header->sequence != mSequence))
+  {
+    reset();
+    return RMSNCR_ERROR;
+  }
+
+  if(mReceived + payloadLen > mSize)
+  {
+    reset();
+    return RMSNCR_ERROR;
+  }
+
+  memcpy(mArena + mReceived, payload, payloadLen);
+  mReceived += payloadLen;
+  ++mSequence;
+
+  if(header->flags & RMSN_CHUNK_FLAG_LAST)
+  {
+    mIsStarted = false;
+
+    if(mReceived != mSize)
+    {
+      reset();
+      return RMSNCR_ERROR;
+    }
+
+    return RMSNCR_COMPLETE;
+  }
+
+  return RMSNCR_INCOMPLETE;
+}
+
+void
+RMSNChunkAssembler::reset()
+{
+  mSize      = 0;
+  mReceived  = 0;
+  mTopicId   = RMSN_INVALID_TOPIC_ID;
+  mSequence  = 0;
+  mIsStarted = false;
+}
+
+const uint8_t *
+RMSNChunkAssembler::data() const
+{
+  return mArena;
+}
+
+uint16_t
+RMSNChunkAssembler::size() const
+{
+  return mSize;
+}
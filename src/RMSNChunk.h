@@ -0,0 +1,159 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_0497654D2AE911E7AA6EA088B4D1658C
+#define __INCLUDED_0497654D2AE911E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+#include "RMSNRequest.h"
+
+#define RMSN_CHUNK_FLAG_FIRST 0x80
+#define RMSN_CHUNK_FLAG_LAST  0x40
+/// Wait before sending a chunk again that was rejected for congestion
+#define RMSN_CHUNK_RETRY_DELAY (RMSN_T_RETRY * 1000L)
+
+/**
+ * @brief The RMSNChunkHeader struct
+ *
+ * Leads the payload of every chunk frame. The first chunk is followed by
+ * the total payload size in network byte order.
+ */
+struct RMSNChunkHeader
+{
+  uint8_t flags;
+  uint8_t sequence;
+} RMSN_STRUCT_PACKED;
+
+enum RMSNChunkResult
+{
+  RMSNCR_INCOMPLETE,
+  RMSNCR_COMPLETE,
+  /// Missing chunk, unexpected chunk or the payload exceeds the arena. The
+  /// partial payload is dropped.
+  RMSNCR_ERROR,
+};
+
+class RMSNClient;
+
+/**
+ * @brief The RMSNChunkPublisher class
+ *
+ * Publishes a payload larger than one frame as a sequence of chunk frames.
+ * Chunks are written straight into the client's publish frame, the next
+ * one is sent as soon as the client finished the previous one, so QoS 0
+ * chunks go out back to back and QoS 1 chunks follow each PUBACK.
+ */
+class RMSNChunkPublisher
+{
+public:
+  RMSNChunkPublisher(RMSNClient *client);
+
+  /**
+   * @brief Start publishing
+   *
+   * @param data Must stay valid until finished.
+   * @param chunkSize Maximum payload bytes per chunk, 0 for the largest
+   * chunk fitting into a frame.
+   */
+  void
+  begin(const uint16_t topicId, const void *data, const uint16_t size,
+        const uint8_t chunkSize=0);
+
+  /**
+   * @brief Send the next chunk once the previous one is accepted, call it
+   * from the event loop until it returns false.
+   *
+   * A chunk rejected for congestion is sent again after
+   * RMSN_CHUNK_RETRY_DELAY, up to RMSN_N_RETRY times. Any other reject or a
+   * timeout fails the payload.
+   *
+   * @return true while chunks are still to be sent or acknowledged.
+   */
+  bool
+  process();
+
+  bool
+  isFinished() const;
+  bool
+  isFailed() const;
+
+  /// Bytes sent so far
+  uint16_t
+  sent() const;
+
+private:
+  RMSNClient    *mClient;
+  const uint8_t *mData;
+  uint16_t       mSize;
+  uint16_t       mSent;
+  uint16_t       mTopicId;
+  uint8_t        mChunkSize;
+  uint8_t        mSequence;
+  bool           mIsFailed;
+  /// Request of the last chunk sent, invalid before the first one
+  RMSNRequest    mRequest;
+  uint8_t        mLastChunkSize;
+  uint8_t        mRetries;
+  uint32_t       mRetryTime;
+};
+
+/**
+ * @brief The RMSNChunkAssembler class
+ *
+ * Reassembles chunk frames of one topic into a caller provided arena.
+ */
+class RMSNChunkAssembler
+{
+public:
+  RMSNChunkAssembler(uint8_t *arena, const uint16_t arenaSize);
+
+  /**
+   * @brief Feed a received chunk frame
+   *
+   * After RMSNCR_COMPLETE, data() and size() describe the payload until the
+   * next chunk is fed.
+   */
+  RMSNChunkResult
+  feed(const RMSNMsgPublish *msg);
+
+  void
+  reset();
+
+  const uint8_t *
+  data() const;
+  uint16_t
+  size() const;
+
+private:
+  uint8_t *mArena;
+  uint16_t mArenaSize;
+  uint16_t mSize;
+  uint16_t mReceived;
+  uint16_t mTopicId;
+  uint8_t  mSequence;
+  bool     mIsStarted;
+};
+
+#endif // __INCLUDED_0497654D2AE911E7AA6EA088B4D1658C
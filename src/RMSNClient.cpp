@@ -31,37 +31,117 @@
 #include <RByteOrder.h>
 #include "RMSNClient.h"
 #include "RMSNUtils.h"
+#include "RMSNTrace.h"
+#include "RMSNCodec.h"
+#include "RMSNSubmitQueue.h"
+#include "RMSNTimerWheel.h"
+#include "RMSNWill.h"
+#include "RMSNPublishTemplate.h"
+#include "RMSNValueCache.h"
+
+static_assert(RMSN_MAX_TOPICS + RMSN_MAX_SUBSCRIPTIONS
+              <= RMSN_PIPELINE_MAX_ITEMS,
+              "The session renewal can't carry all topics and subscriptions");
+
+#ifdef __AVR__
+// Subscriptions other than the default 8, and the wider pipelines they
+// may need, are paid for by whoever sets RMSN_MAX_SUBSCRIPTIONS.
+#define RMSN_SUBSCRIPTIONS_BUDGET \
+  ((RMSN_MAX_SUBSCRIPTIONS - 8) * 5 + (RMSN_PIPELINE_MAX_ITEMS - 32) / 4)
+
+// RAM budget of one client on AVR, raise it knowingly when adding state.
+#ifdef RMSN_USE_SINGLE_BUFFER
+#define RMSN_CLIENT_SIZE_BUDGET (384 + RMSN_SUBSCRIPTIONS_BUDGET)
+#else
+#define RMSN_CLIENT_SIZE_BUDGET (512 + RMSN_SUBSCRIPTIONS_BUDGET)
+#endif
+
+#ifdef RMSN_USE_METRICS
+#ifdef RMSN_USE_METRICS_BYTES
+#define RMSN_METRICS_SIZE_BUDGET (176 + RMSN_METRICS_MSG_TYPES * 8)
+#else
+#define RMSN_METRICS_SIZE_BUDGET 176
+#endif
+static_assert(sizeof(RMSNMetrics) <= RMSN_METRICS_SIZE_BUDGET,
+              "RMSNMetrics outgrew its budget");
+static_assert(sizeof(RMSNClient) <= RMSN_CLIENT_SIZE_BUDGET
+              + RMSN_METRICS_SIZE_BUDGET + 8,
+              "RMSNClient outgrew its RAM budget");
+#else
+static_assert(sizeof(RMSNClient) <= RMSN_CLIENT_SIZE_BUDGET,
+              "RMSNClient outgrew its RAM budget");
+#endif
+#endif // __AVR__
 
 RMSNClient::RMSNClient() :
   mResponseToWaitFor(RMSNMT_INVALID),
   mMessageId(0),
   mTopicCount(0),
+  mPublishOrderCount(0),
+  mRequestFrame(mMessageBuffer),
+  mLastRequestId(0),
+  mNextRequest(0),
+  mPendingRequest(0),
+  mResponseResult(RMSNRR_ACCEPTED),
+  mIsReadinessDriven(false),
+  mIsReadable(false),
+  mSubmitQueue(NULL),
   mGatewayId(0),
   mFlags(RMSN_FLAG_QOS_0),
   mIsTimeout(false),
   mKeepAliveInterval(30),
   mStream(NULL),
-  mResponseRetries(0)
+  mResponseRetries(0),
+  mCodec(NULL),
+  mWill(NULL),
+  mValueCache(NULL),
+  mSubscriptionCount(0),
+  mRegisteredTopics(0),
+  mConnectionState(RMSN_CONNECTION_DISCONNECTED),
+  mIsAutoReconnect(false),
+  mIsSessionLost(false),
+  mSessionGeneration(0),
+  mReconnectAttempts(0),
+  mJitterState(0),
+  mRebuild(sendRebuildFrame, onRebuildTimeout, this),
+  mRebuildTopicCount(0),
+  mBatch(sendBatchFrame, onBatchTimeout, this),
+  mBatchTopics(NULL),
+  mBatchGranted(NULL),
+  mBatchRequest(0),
+  mBatchResult(RMSNRR_ACCEPTED),
+  mInboundMessageId(0),
+  mInboundWindow(0)
 {
   memset(mTopicTable, 0, sizeof(RMSNTopic) * RMSN_MAX_TOPICS);
+  memset(mClientId, 0, sizeof(mClientId));
   memset(mMessageBuffer, 0, RMSN_MAX_BUFFER_SIZE);
+  memset(mPublishSlotStates, RMSN_PUBLISH_SLOT_FREE,
+         sizeof(mPublishSlotStates));
+  memset(mRequests, 0, sizeof(mRequests));
+  memset(mPublishRequests, 0, sizeof(mPublishRequests));
+  memset(mSubscriptions, 0, sizeof(mSubscriptions));
+#ifndef RMSN_USE_SINGLE_BUFFER
   memset(mResponseBuffer, 0, RMSN_MAX_BUFFER_SIZE);
+#endif
 
-  {
-    auto headerSize = sizeof(RMSNMsgPublish);
-
-    mPubPayloadStream.setBuffer(
-      mMessageBuffer + headerSize, RMSN_MAX_BUFFER_SIZE - headerSize);
-  }
+#ifdef RMSN_USE_METRICS
+  mMetrics.reset();
+  mRequestTime = 0;
+  mLostTime    = 0;
+#endif
 
-  mResponseTimer.setSingleShot(false);
-  mResponseTimer.setInterval(RMSN_T_RETRY * 1000L);
-  R_CONNECT(&mResponseTimer, timeout, this, onResponseTimerTimeout);
-  R_CONNECT(rCoreApp->thread()->eventLoop(), idle, this, parseStream);
+  mResponseTimer.callback  = onResponseTimerExpired;
+  mResponseTimer.context   = this;
+  mReconnectTimer.callback = onReconnectTimerExpired;
+  mReconnectTimer.context  = this;
+  R_CONNECT(rCoreApp->thread()->eventLoop(), idle, this, onIdle);
 }
 
 RMSNClient::~RMSNClient()
 {
+  RMSNTimerWheel::instance()->cancel(&mResponseTimer);
+  RMSNTimerWheel::instance()->cancel(&mReconnectTimer);
 }
 
 void
@@ -96,7 +176,7 @@ RMSNClient::setTopic(const char *name, const uint16_t &id)
   {
     const_cast<RMSNTopic *>(topic)->id = id;
   }
-  else if(mTopicCount <= RMSN_MAX_TOPICS)
+  else if(mTopicCount < RMSN_MAX_TOPICS)
   {
     mTopicTable[mTopicCount].name = name;
     mTopicTable[mTopicCount].id   = id;
@@ -122,6 +202,22 @@ RMSNClient::getTopicByName(const char *name) const
   return NULL;
 }
 
+RMSNTopic *
+RMSNClient::findTopic(const char *name, const uint8_t nameLen)
+{
+  for(uint8_t i = 0; i < mTopicCount; ++i)
+  {
+    const char *topicName = mTopicTable[i].name;
+
+    if((strncmp(topicName, name, nameLen) == 0) && (0 == topicName[nameLen]))
+    {
+      return &mTopicTable[i];
+    }
+  }
+
+  return NULL;
+}
+
 const RMSNTopic *
 RMSNClient::getTopicById(const uint16_t &id) const
 {
@@ -147,219 +243,450 @@ RMSNClient::parseStream()
 
   if(mStream->available() > 0)
   {
-    uint8_t *response     = mResponseBuffer;
-    uint8_t  packetLength = (uint8_t)mStream->read();
+    // The whole frame must arrive within RMSN_RX_FRAME_TIMEOUT, a stalled
+    // stream blocks us once per frame and not once per byte.
+    const uint32_t startTime    = millis();
+    uint16_t       packetLength = (uint8_t)mStream->read();
+    uint8_t        headerLength = 1;
+
+    if(RMSN_EXTENDED_LENGTH == packetLength)
+    {
+      // Three bytes length, always larger than our buffers.
+      packetLength  = (uint16_t)readByte(startTime) << 8;
+      packetLength |= (uint8_t)readByte(startTime);
+      headerLength  = 3;
+    }
 
-    *response++ = packetLength--;
+    uint8_t *response = NULL;
 
-    while(packetLength > 0)
+    if(1 == headerLength)
     {
-      while(mStream->available() > 0)
+      response = responseBuffer(static_cast<uint8_t>(packetLength));
+    }
+
+    if(response)
+    {
+      response[0] = static_cast<uint8_t>(packetLength);
+    }
+
+    // Frames we have no room for are read and dropped, so that we stay
+    // synchronized with the stream.
+    for(uint16_t i = headerLength; i < packetLength; ++i)
+    {
+      int c = readByte(startTime);
+
+      if(c < 0)
+      {
+        // The rest of the frame never came, drop what we got.
+#ifdef RMSN_USE_METRICS
+        ++mMetrics.malformedFrames;
+#endif
+        return;
+      }
+
+      if(response)
       {
-        *response++ = (uint8_t)mStream->read();
-        --packetLength;
+        response[i] = static_cast<uint8_t>(c);
       }
     }
 
-    dispatch();
+    if(response)
+    {
+      RMSNMsgHeader *msg = reinterpret_cast<RMSNMsgHeader *>(response);
+
+      RMSN_TRACE(RMSNTE_RECEIVE, msg);
+
+      dispatch(msg);
+    }
   }
 }
 
-void
-RMSNClient::dispatch()
+int
+RMSNClient::readByte(const uint32_t startTime)
 {
-  RMSNMsgHeader *responseMessage = (RMSNMsgHeader *)mResponseBuffer;
-  bool           handled         = true;
-
-  switch(responseMessage->type)
+  while(mStream->available() <= 0)
   {
-  case RMSNMT_ADVERTISE:
-
-    if(mResponseToWaitFor == RMSNMT_ADVERTISE)
-    {
-      advertiseHandler((RMSNMsgAdvertise *)mResponseBuffer);
-    }
-    else
+    if(millis() - startTime >= RMSN_RX_FRAME_TIMEOUT)
     {
-      handled = false;
+      return -1;
     }
+  }
+
+  return mStream->read();
+}
 
-    break;
+void
+RMSNClient::setReadinessDriven(const bool enabled)
+{
+  mIsReadinessDriven = enabled;
 
-  case RMSNMT_GWINFO:
-    gwInfoHandler((RMSNMsgGwInfo *)mResponseBuffer);
-    break;
+  // Bytes may already be waiting, check them once.
+  mIsReadable = true;
+}
 
-  case RMSNMT_CONNACK:
+bool
+RMSNClient::isReadinessDriven() const
+{
+  return mIsReadinessDriven;
+}
 
-    if(mResponseToWaitFor == RMSNMT_CONNACK)
-    {
-      connAckHandler((RMSNMsgConnAck *)mResponseBuffer);
-    }
-    else
+void
+RMSNClient::notifyReadable()
+{
+  mIsReadable = true;
+}
+
+void
+RMSNClient::setSubmitQueue(RMSNSubmitQueue *queue)
+{
+  mSubmitQueue = queue;
+}
+
+void
+RMSNClient::drainSubmitQueue()
+{
+  const RMSNSubmission *submission;
+
+  while((submission = mSubmitQueue->front()) != NULL)
+  {
+    RMSNPublisher publisher = publish(submission->topicId, submission->qos);
+
+    if(!publisher.isValid())
     {
-      handled = false;
+      // No free frame, the rest waits for the next idle loop.
+      return;
     }
 
-    break;
+    publisher.payloadStream()->write(submission->data, submission->dataLen);
+    mSubmitQueue->pop();
+  }
+}
 
-  case RMSNMT_WILLTOPICREQ:
-    willTopicReqHandler(responseMessage);
-    break;
+void
+RMSNClient::onIdle()
+{
+  if(mSubmitQueue)
+  {
+    drainSubmitQueue();
+  }
 
-  case RMSNMT_WILLMSGREQ:
-    willMsgReqHandler(responseMessage);
-    break;
+  if(!mIsReadinessDriven)
+  {
+    parseStream();
+    return;
+  }
 
-  case RMSNMT_REGISTER:
-    registerHandler((RMSNMsgRegister *)mResponseBuffer);
-    break;
+  if(!mIsReadable)
+  {
+    return;
+  }
 
-  case RMSNMT_REGACK:
+  // Cleared before reading, so bytes arriving meanwhile notify again.
+  mIsReadable = false;
 
-    if(mResponseToWaitFor == RMSNMT_REGACK)
-    {
-      regAckHandler((RMSNMsgRegAck *)mResponseBuffer);
-    }
-    else
-    {
-      handled = false;
-    }
+  while(mStream && (mStream->available() > 0))
+  {
+    parseStream();
+  }
+}
 
-    break;
+uint8_t *
+RMSNClient::responseBuffer(const uint8_t length)
+{
+  if(length < sizeof(RMSNMsgHeader))
+  {
+    return NULL;
+  }
 
-  case RMSNMT_PUBLISH:
-    publishHandler((RMSNMsgPublish *)mResponseBuffer);
-    break;
+#ifdef RMSN_USE_SINGLE_BUFFER
+  uint8_t offset = 0;
 
-  case RMSNMT_PUBACK:
+  if(RMSN_PUBLISH_SLOT_BUILDING == mPublishSlotStates[0])
+  {
+    // A publisher is still writing the frame, we don't know its length.
+    return NULL;
+  }
 
-    if(mResponseToWaitFor == RMSNMT_PUBACK)
-    {
-      pubAckHandler((RMSNMsgPubAck *)mResponseBuffer);
-    }
-    else
-    {
-      handled = false;
-    }
+  if((RMSN_PUBLISH_SLOT_FREE != mPublishSlotStates[0])
+     || ((RMSNMT_INVALID != mResponseToWaitFor)
+         && (mRequestFrame == mMessageBuffer)))
+  {
+    // Keep the request we are waiting for, we may need to retransmit it.
+    offset = reinterpret_cast<RMSNMsgHeader *>(mMessageBuffer)->length;
+  }
 
-    break;
+  if(offset + length > RMSN_MAX_BUFFER_SIZE)
+  {
+    return NULL;
+  }
 
-  case RMSNMT_SUBACK:
+  return mMessageBuffer + offset;
+#else
 
-    if(mResponseToWaitFor == RMSNMT_SUBACK)
-    {
-      subAckHandler((RMSNMsgSubAck *)mResponseBuffer);
-    }
-    else
-    {
-      handled = false;
-    }
+  if(length > RMSN_MAX_BUFFER_SIZE)
+  {
+    return NULL;
+  }
 
-    break;
+  return mResponseBuffer;
+#endif
+}
 
-  case RMSNMT_UNSUBACK:
+#define RMSN_DISPATCH_ENTRY(View, handler, minLength, maxLength, flags) \
+  {minLength, maxLength, flags, \
+   &RMSNClient::dispatchTo<View, &RMSNClient::handler>}
+
+#define RMSN_DISPATCH_NONE {0, 0, 0, NULL}
+
+const RMSNClient::DispatchEntry RMSNClient::sDispatchTable[] PROGMEM = {
+  // RMSNMT_ADVERTISE
+  RMSN_DISPATCH_ENTRY(RMSNAdvertiseView, advertiseHandler,
+                      sizeof(RMSNMsgAdvertise), sizeof(RMSNMsgAdvertise),
+                      RMSN_DISPATCH_RESPONSE),
+  // RMSNMT_SEARCHGW
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_GWINFO
+  RMSN_DISPATCH_ENTRY(RMSNGwInfoView, gwInfoHandler,
+                      sizeof(RMSNMsgGwInfo), RMSN_MAX_BUFFER_SIZE, 0),
+  // 0x03
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_CONNECT
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_CONNACK
+  RMSN_DISPATCH_ENTRY(RMSNReturnCodeView, connAckHandler,
+                      sizeof(RMSNMsgConnAck), sizeof(RMSNMsgConnAck),
+                      RMSN_DISPATCH_RESPONSE),
+  // RMSNMT_WILLTOPICREQ
+  RMSN_DISPATCH_ENTRY(RMSNMsgView, willTopicReqHandler,
+                      sizeof(RMSNMsgHeader), sizeof(RMSNMsgHeader), 0),
+  // RMSNMT_WILLTOPIC
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_WILLMSGREQ
+  RMSN_DISPATCH_ENTRY(RMSNMsgView, willMsgReqHandler,
+                      sizeof(RMSNMsgHeader), sizeof(RMSNMsgHeader), 0),
+  // RMSNMT_WILLMSG
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_REGISTER
+  RMSN_DISPATCH_ENTRY(RMSNRegisterView, registerHandler,
+                      sizeof(RMSNMsgRegister) + 1, RMSN_MAX_BUFFER_SIZE, 0),
+  // RMSNMT_REGACK
+  RMSN_DISPATCH_ENTRY(RMSNTopicAckView, regAckHandler,
+                      sizeof(RMSNMsgRegAck), sizeof(RMSNMsgRegAck),
+                      RMSN_DISPATCH_RESPONSE),
+  // RMSNMT_PUBLISH
+  {sizeof(RMSNMsgPublish), RMSN_MAX_BUFFER_SIZE, 0,
+   &RMSNClient::dispatchPublish},
+  // RMSNMT_PUBACK
+  {sizeof(RMSNMsgPubAck), sizeof(RMSNMsgPubAck), RMSN_DISPATCH_RESPONSE,
+   &RMSNClient::dispatchPubAck},
+  // RMSNMT_PUBCOMP, RMSNMT_PUBREC, RMSNMT_PUBREL
+  RMSN_DISPATCH_NONE,
+  RMSN_DISPATCH_NONE,
+  RMSN_DISPATCH_NONE,
+  // 0x11
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_SUBSCRIBE
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_SUBACK
+  RMSN_DISPATCH_ENTRY(RMSNSubAckView, subAckHandler,
+                      sizeof(RMSNMsgSubAck), sizeof(RMSNMsgSubAck),
+                      RMSN_DISPATCH_RESPONSE),
+  // RMSNMT_UNSUBSCRIBE
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_UNSUBACK
+  RMSN_DISPATCH_ENTRY(RMSNMessageIdView, unsubAckHandler,
+                      sizeof(RMSNMsgUnsubAck), sizeof(RMSNMsgUnsubAck),
+                      RMSN_DISPATCH_RESPONSE),
+  // RMSNMT_PINGREQ
+  RMSN_DISPATCH_ENTRY(RMSNMsgView, pingReqHandler,
+                      sizeof(RMSNMsgPingReq), RMSN_MAX_BUFFER_SIZE, 0),
+  // RMSNMT_PINGRESP
+  RMSN_DISPATCH_ENTRY(RMSNMsgView, pingRespHandler,
+                      sizeof(RMSNMsgHeader), sizeof(RMSNMsgHeader),
+                      RMSN_DISPATCH_RESPONSE),
+  // RMSNMT_DISCONNECT
+  RMSN_DISPATCH_ENTRY(RMSNDisconnectView, disconnectHandler,
+                      sizeof(RMSNMsgHeader), sizeof(RMSNMsgDisconnect), 0),
+  // 0x19
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_WILLTOPICUPD
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_WILLTOPICRESP
+  RMSN_DISPATCH_ENTRY(RMSNReturnCodeView, willTopicRespHandler,
+                      sizeof(RMSNMsgWillTopicResp),
+                      sizeof(RMSNMsgWillTopicResp), RMSN_DISPATCH_RESPONSE),
+  // RMSNMT_WILLMSGUPD
+  RMSN_DISPATCH_NONE,
+  // RMSNMT_WILLMSGRESP
+  RMSN_DISPATCH_ENTRY(RMSNReturnCodeView, willMsgRespHandler,
+                      sizeof(RMSNMsgWillMsgResp), sizeof(RMSNMsgWillMsgResp),
+                      RMSN_DISPATCH_RESPONSE),
+};
+
+#undef RMSN_DISPATCH_ENTRY
+#undef RMSN_DISPATCH_NONE
+
+template <class View, void (RMSNClient::*handler)(const View &)>
+bool
+RMSNClient::dispatchTo(RMSNClient *client, const RMSNMsgHeader *msg)
+{
+  (client->*handler)(View(msg));
+  return true;
+}
 
-    if(mResponseToWaitFor == RMSNMT_UNSUBACK)
-    {
-      unsubAckHandler((RMSNMsgUnsubAck *)mResponseBuffer);
-    }
-    else
-    {
-      handled = false;
-    }
+bool
+RMSNClient::dispatchPublish(RMSNClient *client, const RMSNMsgHeader *msg)
+{
+  // The frame is in our own receive buffer, the payload is decoded in place.
+  return client->publishHandler(
+    reinterpret_cast<RMSNMsgPublish *>(const_cast<RMSNMsgHeader *>(msg)));
+}
 
-    break;
+bool
+RMSNClient::dispatchPubAck(RMSNClient *client, const RMSNMsgHeader *msg)
+{
+  return client->pubAckHandler(RMSNTopicAckView(msg));
+}
 
-  case RMSNMT_PINGREQ:
-    pingReqHandler((RMSNMsgPingReq *)mResponseBuffer);
-    break;
+void
+RMSNClient::dispatch(const RMSNMsgHeader *responseMessage)
+{
+  DispatchEntry entry;
+  bool          handled = true;
 
-  case RMSNMT_PINGRESP:
+#ifdef RMSN_USE_METRICS
+  mMetrics.countRx(responseMessage);
+#endif
 
-    if(mResponseToWaitFor == RMSNMT_PINGRESP)
-    {
-      pingRespHandler();
-    }
-    else
-    {
-      handled = false;
-    }
+  if(responseMessage->type
+     >= (sizeof(sDispatchTable) / sizeof(sDispatchTable[0])))
+  {
+    received.emit(responseMessage);
+    return;
+  }
 
-    break;
+  memcpy_P(&entry, &sDispatchTable[responseMessage->type], sizeof(entry));
 
-  case RMSNMT_DISCONNECT:
-    disconnectHandler((RMSNMsgDisconnect *)mResponseBuffer);
-    break;
+  if(NULL == entry.handler)
+  {
+    // Nothing to do with it, let the application decide.
+    received.emit(responseMessage);
+    return;
+  }
 
-  case RMSNMT_WILLTOPICRESP:
+  if((responseMessage->length < entry.minLength)
+     || (responseMessage->length > entry.maxLength))
+  {
+    // Malformed, no handler nor the application will see it.
+    RMSN_TRACE(RMSNTE_MALFORMED, responseMessage);
+#ifdef RMSN_USE_METRICS
+    ++mMetrics.malformedFrames;
+#endif
+    return;
+  }
 
-    if(mResponseToWaitFor == RMSNMT_WILLTOPICRESP)
-    {
-      willTopicRespHandler((RMSNMsgWillTopicResp *)mResponseBuffer);
-    }
-    else
-    {
-      handled = false;
-    }
+  // Responses without a return code are simply accepted.
+  mResponseResult = RMSNRR_ACCEPTED;
 
-    break;
+  if(mRebuild.isActive() && rebuildAckHandler(responseMessage))
+  {
+    // Part of the session renewal, the application did not ask for it.
+    RMSN_TRACE(RMSNTE_DISPATCH, responseMessage);
+    flushPublishes();
+    return;
+  }
 
-  case RMSNMT_WILLMSGRESP:
+  if(mBatch.isActive() && batchAckHandler(responseMessage))
+  {
+    // Reported by the completion of the batch.
+    RMSN_TRACE(RMSNTE_DISPATCH, responseMessage);
+    flushPublishes();
+    return;
+  }
 
-    if(mResponseToWaitFor == RMSNMT_WILLMSGRESP)
+  if((entry.flags & RMSN_DISPATCH_RESPONSE)
+     && (mResponseToWaitFor != responseMessage->type))
+  {
+    handled = false;
+  }
+  else if(!entry.handler(this, responseMessage))
+  {
+    if(entry.flags & RMSN_DISPATCH_RESPONSE)
     {
-      willMsgRespHandler((RMSNMsgWillMsgResp *)mResponseBuffer);
+      // Of the type we wait for, but answering another request.
+      handled = false;
     }
     else
     {
-      handled = false;
+      // Acknowledged, but nothing the application should see.
+      flushPublishes();
+      return;
     }
+  }
 
-    break;
+  RMSN_TRACE(handled ? RMSNTE_DISPATCH : RMSNTE_UNMATCHED, responseMessage);
 
-  default:
-    received.emit(responseMessage);
-    return;
-  }
+#ifdef RMSN_USE_METRICS
 
-  if(handled)
+  if(!handled)
   {
-    if(mResponseToWaitFor != RMSNMT_INVALID)
-    {
-      // If responsed, we stop the response timer.
-      mResponseTimer.stop();
-    }
+    ++mMetrics.unmatchedResponses;
+  }
+  else if(responseMessage->type == mResponseToWaitFor)
+  {
+    mMetrics.recordRtt(millis() - mRequestTime);
+  }
 
-    mResponseToWaitFor = RMSNMT_INVALID;
+#endif
+
+  if(handled && (responseMessage->type == mResponseToWaitFor))
+  {
+    // Responsed, the response timer stops with it.
+    setResponseToWaitFor(RMSNMT_INVALID);
+    completeRequest(mPendingRequest,
+                    static_cast<RMSNRequestResult>(mResponseResult));
   }
 
   received.emit(responseMessage);
+
+  flushPublishes();
+}
+
+void
+RMSNClient::writeMessage(const RMSNMsgHeader *msg)
+{
+  mStream->write(reinterpret_cast<const uint8_t *>(msg), msg->length);
+  mStream->flush();
+
+  RMSN_TRACE(RMSNTE_SEND, msg);
+
+#ifdef RMSN_USE_METRICS
+  mMetrics.countTx(msg);
+#endif
 }
 
 void
 RMSNClient::sendMessage()
 {
-  RMSNMsgHeader *hdr = reinterpret_cast<RMSNMsgHeader *>(mMessageBuffer);
+  sendFrame(mMessageBuffer);
+}
 
-  mIsTimeout = false;
+void
+RMSNClient::sendFrame(uint8_t *frame)
+{
+  mIsTimeout    = false;
+  mRequestFrame = frame;
 
-  mStream->write(mMessageBuffer, hdr->length);
-  mStream->flush();
+  writeMessage(reinterpret_cast<RMSNMsgHeader *>(frame));
+
+#ifdef RMSN_USE_METRICS
 
   if(RMSNMT_INVALID == mResponseToWaitFor)
   {
-    startResponseTimer();
-
-    // Cheesy hack to ensure two messages don't run-on into one send.
-//        delay(10);
+    mRequestTime = millis();
   }
-}
 
-RBufferStream *
-RMSNClient::pubPayloadStream()
-{
-  return &mPubPayloadStream;
+#endif
 }
 
 bool
@@ -386,581 +713,1844 @@ RMSNClient::responseToWaitFor() const
   return mResponseToWaitFor;
 }
 
-String
+const char *
 RMSNClient::clientId() const
 {
   return mClientId;
 }
 
 void
-RMSNClient::setClientId(const String &clientId)
+RMSNClient::setClientId(const char *clientId)
 {
-  mClientId = clientId;
+  // Longer client ids are truncated, the protocol only allows 23 characters.
+  fmsnSafeCopyText(mClientId, clientId, sizeof(mClientId));
 }
 
-uint16_t
-RMSNClient::keepAliveInterval() const
+#ifdef RMSN_USE_METRICS
+const RMSNMetrics *
+RMSNClient::metrics() const
 {
-  return mKeepAliveInterval;
+  return &mMetrics;
 }
 
 void
-RMSNClient::setKeepAliveInterval(const uint16_t &keepAliveInterval)
+RMSNClient::resetMetrics()
 {
-  mKeepAliveInterval = keepAliveInterval;
+  mMetrics.reset();
 }
 
-void
-RMSNClient::timeout()
-{
-  mResponseToWaitFor = RMSNMT_INVALID;
-  mIsTimeout         = true;
-}
+#endif
 
-void
-RMSNClient::advertiseHandler(const RMSNMsgAdvertise *msg)
+uint16_t
+RMSNClient::keepAliveInterval() const
 {
-  mGatewayId = msg->gwId;
+  return mKeepAliveInterval;
 }
 
 void
-RMSNClient::gwInfoHandler(const RMSNMsgGwInfo *msg)
+RMSNClient::setKeepAliveInterval(const uint16_t &keepAliveInterval)
 {
+  mKeepAliveInterval = keepAliveInterval;
 }
 
 void
-RMSNClient::connAckHandler(const RMSNMsgConnAck *msg)
+RMSNClient::setResponseToWaitFor(const uint8_t type)
 {
-}
+  if(type != mResponseToWaitFor)
+  {
+    RMSN_TRACE_STATE(mResponseToWaitFor, type);
+  }
 
-void
-RMSNClient::willTopicReqHandler(const RMSNMsgHeader *msg)
-{
-}
+  if(RMSNMT_INVALID == type)
+  {
+    RMSNTimerWheel::instance()->cancel(&mResponseTimer);
+  }
+  else if(RMSNMT_INVALID == mResponseToWaitFor)
+  {
+    // Only armed while a response is expected, retransmissions of the same
+    // request keep their retry count.
+    startResponseTimer();
+  }
 
-void
-RMSNClient::willMsgReqHandler(const RMSNMsgHeader *msg)
-{
+  mResponseToWaitFor = type;
 }
 
-void
-RMSNClient::regAckHandler(const RMSNMsgRegAck *msg)
+uint8_t
+RMSNClient::beginRequest()
 {
-  if((msg->returnCode == 0)
-     && (mTopicCount > 0)
-     && (mTopicCount < RMSN_MAX_TOPICS)
-     && rNtohs(msg->messageId) == mMessageId)
+  // Reuse the oldest completed entry, pending ones are kept.
+  for(uint8_t i = 0; i < RMSN_MAX_REQUESTS; ++i)
   {
-    const uint16_t topicId = rNtohs(msg->topicId);
+    RequestEntry &entry = mRequests[mNextRequest];
 
-    if(NULL == getTopicById(topicId))
+    mNextRequest = (mNextRequest + 1) % RMSN_MAX_REQUESTS;
+
+    if((0 == entry.id) || (RMSNRR_PENDING != entry.result))
     {
-      // If we don't have that topic id, we reset the last topic id.
-      setTopic(mTopicTable[mTopicCount - 1].name, topicId);
+      if(0 == ++mLastRequestId)
+      {
+        // Zero marks an invalid request.
+        mLastRequestId = 1;
+      }
+
+      entry.id       = mLastRequestId;
+      entry.result   = RMSNRR_PENDING;
+      entry.callback = NULL;
+      entry.context  = NULL;
+
+      return entry.id;
     }
   }
-}
 
-void
-RMSNClient::pubAckHandler(const RMSNMsgPubAck *msg)
-{
+  return 0;
 }
 
-#ifdef USE_QOS2
 void
-MQTTSN::pubrecHandler(const msg_pubqos2 *msg)
+RMSNClient::completeRequest(const uint8_t id, const RMSNRequestResult result)
 {
-}
+  if(0 == id)
+  {
+    return;
+  }
 
-void
-MQTTSN::pubrelHandler(const msg_pubqos2 *msg)
-{
+  if(id == mPendingRequest)
+  {
+    mPendingRequest = 0;
+  }
+
+  for(uint8_t i = 0; i < RMSN_MAX_REQUESTS; ++i)
+  {
+    RequestEntry &entry = mRequests[i];
+
+    if((entry.id == id) && (RMSNRR_PENDING == entry.result))
+    {
+      entry.result = result;
+
+      if(entry.callback)
+      {
+        entry.callback(entry.context, id, result);
+      }
+
+      return;
+    }
+  }
+}
+
+RMSNRequestResult
+RMSNClient::requestResult(const uint8_t id) const
+{
+  for(uint8_t i = 0; i < RMSN_MAX_REQUESTS; ++i)
+  {
+    if(mRequests[i].id == id)
+    {
+      return static_cast<RMSNRequestResult>(mRequests[i].result);
+    }
+  }
+
+  return RMSNRR_UNKNOWN;
+}
+
+void
+RMSNClient::setRequestCallback(const uint8_t id, RMSNRequestCallback callback,
+                               void *context)
+{
+  for(uint8_t i = 0; i < RMSN_MAX_REQUESTS; ++i)
+  {
+    RequestEntry &entry = mRequests[i];
+
+    if(entry.id != id)
+    {
+      continue;
+    }
+
+    if(RMSNRR_PENDING == entry.result)
+    {
+      entry.callback = callback;
+      entry.context  = context;
+    }
+    else if(callback)
+    {
+      callback(context, id, static_cast<RMSNRequestResult>(entry.result));
+    }
+
+    return;
+  }
+
+  if(callback)
+  {
+    callback(context, id, RMSNRR_UNKNOWN);
+  }
+}
+
+RMSNRequest
+RMSNClient::sendRequest(const uint8_t responseType)
+{
+  if(RMSNMT_INVALID == responseType)
+  {
+    return sendUnacked(reinterpret_cast<RMSNMsgHeader *>(mMessageBuffer));
+  }
+
+  // Only one response is waited for, an older request loses its response.
+  completeRequest(mPendingRequest, RMSNRR_CANCELLED);
+
+  const uint8_t id = beginRequest();
+
+  sendMessage();
+
+  mPendingRequest = id;
+  setResponseToWaitFor(responseType);
+
+  return RMSNRequest(this, id);
+}
+
+RMSNRequest
+RMSNClient::sendUnacked(const RMSNMsgHeader *msg)
+{
+  // The pending request keeps waiting for its response.
+  const uint8_t id = beginRequest();
+
+  writeMessage(msg);
+  completeRequest(id, RMSNRR_ACCEPTED);
+
+  return RMSNRequest(this, id);
+}
+
+void
+RMSNClient::timeout()
+{
+  setResponseToWaitFor(RMSNMT_INVALID);
+  mIsTimeout         = true;
+
+  completeRequest(mPendingRequest, RMSNRR_TIMEOUT);
+}
+
+void
+RMSNClient::advertiseHandler(const RMSNAdvertiseView &msg)
+{
+  if(msg.isValid())
+  {
+    mGatewayId = msg.gwId();
+  }
+}
+
+void
+RMSNClient::gwInfoHandler(const RMSNGwInfoView &msg)
+{
+}
+
+void
+RMSNClient::connAckHandler(const RMSNReturnCodeView &msg)
+{
+  mResponseResult = msg.returnCode();
+
+  if(RMSNRC_ACCEPTED != msg.returnCode())
+  {
+    connectionLost();
+    return;
+  }
+
+  mConnectionState   = RMSN_CONNECTION_CONNECTED;
+  mReconnectAttempts = 0;
+
+  // The gateway numbers its publishes again in a new session.
+  mInboundMessageId = 0;
+  mInboundWindow    = 0;
+
+  if(mIsSessionLost)
+  {
+    mIsSessionLost = false;
+    startRebuild();
+  }
+}
+
+void
+RMSNClient::willTopicReqHandler(const RMSNMsgView &msg)
+{
+  if(mWill)
+  {
+    writeMessage(mWill->willTopicFrame());
+  }
+  else
+  {
+    // An empty WILLTOPIC tells the gateway we have no will.
+    willTopic(NULL);
+  }
+}
+
+void
+RMSNClient::willMsgReqHandler(const RMSNMsgView &msg)
+{
+  if(mWill && mWill->isSet())
+  {
+    writeMessage(mWill->willMsgFrame());
+  }
+}
+
+void
+RMSNClient::regAckHandler(const RMSNTopicAckView &msg)
+{
+  mResponseResult = msg.returnCode();
+
+  if(msg.isValid()
+     && (msg.returnCode() == RMSNRC_ACCEPTED)
+     && (mTopicCount > 0)
+     && (mTopicCount < RMSN_MAX_TOPICS)
+     && (msg.messageId() == mMessageId))
+  {
+    const uint16_t topicId = msg.topicId();
+
+    if(NULL == getTopicById(topicId))
+    {
+      // If we don't have that topic id, we reset the last topic id.
+      setTopic(mTopicTable[mTopicCount - 1].name, topicId);
+    }
+  }
+}
+
+bool
+RMSNClient::pubAckHandler(const RMSNTopicAckView &msg)
+{
+  if((0 == mPublishOrderCount)
+     || (RMSN_PUBLISH_SLOT_SENT != mPublishSlotStates[mPublishOrder[0]]))
+  {
+    return false;
+  }
+
+  const RMSNMsgPublish *publish = reinterpret_cast<const RMSNMsgPublish *>(
+    publishFrame(mPublishOrder[0]));
+
+  if((rNtohs(publish->messageId) != msg.messageId())
+     || (rNtohs(publish->topicId) != msg.topicId()))
+  {
+    // A late PUBACK of an earlier attempt, or of somebody else.
+    return false;
+  }
+
+  mResponseResult = msg.returnCode();
+  return true;
+}
+
+#ifdef USE_QOS2
+void
+MQTTSN::pubrecHandler(const msg_pubqos2 *msg)
+{
+}
+
+void
+MQTTSN::pubrelHandler(const msg_pubqos2 *msg)
+{
+}
+
+void
+MQTTSN::pubcompHandler(const msg_pubqos2 *msg)
+{
+}
+
+#endif
+
+void
+RMSNClient::pingReqHandler(const RMSNMsgView &msg)
+{
+  pingResp();
+}
+
+void
+RMSNClient::subAckHandler(const RMSNSubAckView &msg)
+{
+  mResponseResult = msg.returnCode();
+
+  const RMSNMsgSubscribe *request =
+    reinterpret_cast<const RMSNMsgSubscribe *>(mRequestFrame);
+
+  if((RMSNMT_SUBSCRIBE != request->type)
+     || (rNtohs(request->messageId) != msg.messageId()))
+  {
+    return;
+  }
+
+  const bool isByName =
+    ((request->flags & RMSN_TOPIC_MASK) == RMSN_FLAG_TOPIC_NAME);
+  // The -2 here is because we're unioning a 0-length member (topicName)
+  // with a uint16_t in the msg_subscribe struct.
+  const char *name = isByName
+    ? findSubscriptionName(request->topicName,
+                           request->length - (sizeof(RMSNMsgSubscribe) - 2))
+    : NULL;
+
+  if(RMSNRC_ACCEPTED != msg.returnCode())
+  {
+    // Not subscribed, so nothing to renew after a reconnection.
+    if(name)
+    {
+      removeSubscription(name, 0);
+    }
+    else if(!isByName)
+    {
+      removeSubscription(NULL, rNtohs(request->topicId));
+    }
+
+    return;
+  }
+
+  // Wildcard subscriptions are answered with topic id 0.
+  if(name && (msg.topicId() != 0))
+  {
+    setTopic(name, msg.topicId());
+  }
+}
+
+void
+RMSNClient::unsubAckHandler(const RMSNMessageIdView &msg)
+{
+}
+
+void
+RMSNClient::disconnectHandler(const RMSNDisconnectView &msg)
+{
+  // Without a message our request timed out. Our own DISCONNECT is
+  // acknowledged by one, the connection was already given up.
+  connectionLost();
+}
+
+bool
+RMSNClient::batchAckHandler(const RMSNMsgHeader *msg)
+{
+  if(RMSNMT_SUBACK != msg->type)
+  {
+    return false;
+  }
+
+  const RMSNSubAckView view(msg);
+  const int8_t         item = mBatch.find(view.messageId());
+
+  if(item < 0)
+  {
+    return false;
+  }
+
+  const RMSNReturnCode returnCode = view.returnCode();
+
+  if(RMSNRC_REJECTED_CONGESTION == returnCode)
+  {
+    // Still in flight, sent again with the retransmissions.
+    return true;
+  }
+
+  if(RMSNRC_ACCEPTED == returnCode)
+  {
+    mBatchGranted[item] = view.flags() & RMSN_QOS_MASK;
+
+    if(view.topicId() != 0)
+    {
+      setTopic(mBatchTopics[item], view.topicId());
+    }
+  }
+  else
+  {
+    // Not subscribed, so nothing to renew after a reconnection.
+    removeSubscription(mBatchTopics[item], 0);
+
+    if(RMSNRR_ACCEPTED == mBatchResult)
+    {
+      mBatchResult = returnCode;
+    }
+  }
+
+  if(mBatch.acknowledge(item))
+  {
+    finishBatch(static_cast<RMSNRequestResult>(mBatchResult));
+  }
+
+  return true;
+}
+
+bool
+RMSNClient::rebuildAckHandler(const RMSNMsgHeader *msg)
+{
+  uint16_t       messageId;
+  RMSNReturnCode returnCode;
+  uint16_t       topicId;
+
+  if(RMSNMT_REGACK == msg->type)
+  {
+    const RMSNTopicAckView view(msg);
+
+    messageId  = view.messageId();
+    returnCode = view.returnCode();
+    topicId    = view.topicId();
+  }
+  else if(RMSNMT_SUBACK == msg->type)
+  {
+    const RMSNSubAckView view(msg);
+
+    messageId  = view.messageId();
+    returnCode = view.returnCode();
+    topicId    = view.topicId();
+  }
+  else
+  {
+    return false;
+  }
+
+  const int8_t item = mRebuild.find(messageId);
+
+  if(item < 0)
+  {
+    return false;
+  }
+
+  const int8_t topicIndex = rebuildTopicIndex(item);
+
+  if((topicIndex >= 0) != (RMSNMT_REGACK == msg->type))
+  {
+    return false;
+  }
+
+  if(RMSNRC_REJECTED_CONGESTION == returnCode)
+  {
+    // Still pending, sent again with the retransmissions.
+    return true;
+  }
+
+  if(RMSNRC_ACCEPTED == returnCode)
+  {
+    if(topicIndex >= 0)
+    {
+      mTopicTable[topicIndex].id = topicId;
+    }
+    else
+    {
+      const Subscription &subscription =
+        mSubscriptions[item - mRebuildTopicCount];
+      RMSNTopic          *topic = NULL;
+
+      if(subscription.name)
+      {
+        topic = findTopic(subscription.name, strlen(subscription.name));
+      }
+
+      if(topic && (topicId != 0))
+      {
+        topic->id = topicId;
+      }
+    }
+  }
+
+  if(mRebuild.acknowledge(item))
+  {
+    finishRebuild();
+  }
+
+  return true;
+}
+
+void
+RMSNClient::pingRespHandler(const RMSNMsgView &msg)
+{
+}
+
+bool
+RMSNClient::publishHandler(RMSNMsgPublish *msg)
+{
+  const RMSNPublishView view(msg);
+
+  if(!view.isValid())
+  {
+    return false;
+  }
+
+  if((view.flags() & RMSN_QOS_MASK) == RMSN_FLAG_QOS_1)
+  {
+    RMSNReturnCode ret = RMSNRC_REJECTED_INVALID_TOPIC_ID;
+
+    if(getTopicById(view.topicId()))
+    {
+      ret = RMSNRC_ACCEPTED;
+    }
+
+    // Acknowledged again, the gateway retransmits because our PUBACK was
+    // lost.
+    pubAck(view.topicId(), view.messageId(), ret);
+
+    if(!acceptInbound(view.messageId(), view.flags() & RMSN_FLAG_DUP))
+    {
+#ifdef RMSN_USE_METRICS
+      ++mMetrics.duplicatePublishes;
+#endif
+      return false;
+    }
+  }
+
+  if(mCodec)
+  {
+    // The frame lives in our own receive buffer, so it's decoded in place.
+#ifdef RMSN_USE_SINGLE_BUFFER
+    const uint8_t *frameEnd = mMessageBuffer + RMSN_MAX_BUFFER_SIZE;
+#else
+    const uint8_t *frameEnd = mResponseBuffer + RMSN_MAX_BUFFER_SIZE;
+#endif
+    const uint8_t maxLength =
+      frameEnd - reinterpret_cast<uint8_t *>(msg->data);
+    const int16_t length = mCodec->decode(
+      view.topicId(), reinterpret_cast<uint8_t *>(msg->data),
+      view.payload().size, maxLength);
+
+    if(length < 0)
+    {
+      return false;
+    }
+
+    msg->length = sizeof(RMSNMsgPublish) + length;
+  }
+
+  if(mValueCache)
+  {
+    storeValue(view.topicId(), reinterpret_cast<const uint8_t *>(msg->data),
+               msg->length - sizeof(RMSNMsgPublish));
+  }
+
+  return true;
+}
+
+void
+RMSNClient::storeValue(const uint16_t topicId, const uint8_t *data,
+                       const uint8_t length)
+{
+  if(mValueCache->store(topicId, data, length) || !mValueCache->hasNames())
+  {
+    return;
+  }
+
+  // An id the cache does not know yet, maybe of a topic watched by name.
+  const RMSNTopic *topic = getTopicById(topicId);
+
+  if(topic && topic->name && mValueCache->bind(topic->name, topicId))
+  {
+    mValueCache->store(topicId, data, length);
+  }
+}
+
+bool
+RMSNClient::acceptInbound(const uint16_t messageId, const bool isDup)
+{
+  const uint16_t age = mInboundMessageId - messageId;
+
+  if((0 == mInboundWindow) || ((0 != age) && (age >= 0x8000)))
+  {
+    // Newer than all we have seen, slide the window up to it.
+    const uint16_t shift = messageId - mInboundMessageId;
+
+    mInboundWindow = ((0 != mInboundWindow) && (shift < RMSN_INBOUND_WINDOW))
+                     ? (mInboundWindow << shift) | 1UL : 1UL;
+    mInboundMessageId = messageId;
+
+    return true;
+  }
+
+  if(age >= RMSN_INBOUND_WINDOW)
+  {
+    // Too old to tell, better delivered twice than lost.
+    return true;
+  }
+
+  const uint32_t bit = 1UL << age;
+
+  if(isDup && (mInboundWindow & bit))
+  {
+    return false;
+  }
+
+  // First transmissions are never dropped, ids may be reused by a
+  // gateway that restarted without telling us.
+  mInboundWindow |= bit;
+
+  return true;
+}
+
+void
+RMSNClient::registerHandler(const RMSNRegisterView &msg)
+{
+  if(!msg.isValid())
+  {
+    return;
+  }
+
+  RMSNReturnCode ret       = RMSNRC_REJECTED_INVALID_TOPIC_ID;
+  const RMSNSpan topicName = msg.topicName();
+
+  // The name in the frame is not NUL terminated.
+  RMSNTopic *topic = findTopic(reinterpret_cast<const char *>(topicName.data),
+                               topicName.size);
+
+  if(topic)
+  {
+    topic->id = msg.topicId();
+
+    ret = RMSNRC_ACCEPTED;
+  }
+
+  regAck(msg.topicId(), msg.messageId(), ret);
+}
+
+void
+RMSNClient::willTopicRespHandler(const RMSNReturnCodeView &msg)
+{
+  mResponseResult = msg.returnCode();
+}
+
+void
+RMSNClient::willMsgRespHandler(const RMSNReturnCodeView &msg)
+{
+  mResponseResult = msg.returnCode();
+}
+
+void
+RMSNClient::searchGw(const uint8_t radius)
+{
+  if(!isRequestFrameFree())
+  {
+    return;
+  }
+
+  RMSNMsgSearchGw *msg = reinterpret_cast<RMSNMsgSearchGw *>(mMessageBuffer);
+
+  msg->length = sizeof(RMSNMsgSearchGw);
+  msg->type   = RMSNMT_SEARCHGW;
+  msg->radius = radius;
+
+  sendRequest(fmsnGetRespondType(msg->type));
+}
+
+RMSNRequest
+RMSNClient::connect()
+{
+  if(!isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  // An attempt of our own replaces the scheduled one.
+  RMSNTimerWheel::instance()->cancel(&mReconnectTimer);
+  mConnectionState = RMSN_CONNECTION_CONNECTING;
+
+  if(mRebuild.isActive())
+  {
+    // Renewed from the start once connected.
+    mRebuild.cancel();
+    mIsSessionLost = true;
+  }
+
+  RMSNMsgConnect *msg = reinterpret_cast<RMSNMsgConnect *>(mMessageBuffer);
+
+  const uint8_t clientIdLen = static_cast<uint8_t>(strlen(mClientId));
+
+  msg->length     = static_cast<uint8_t>(sizeof(RMSNMsgConnect) + clientIdLen);
+  msg->type       = RMSNMT_CONNECT;
+  msg->flags      = mFlags & ~RMSN_FLAG_WILL;
+  msg->protocolId = RMSN_PROTOCOL_ID;
+  msg->duration   = rHtons(mKeepAliveInterval);
+
+  memcpy(msg->clientId, mClientId, clientIdLen);
+
+  if(mWill && mWill->isSet())
+  {
+    // The gateway asks for the will before the CONNACK.
+    msg->flags |= RMSN_FLAG_WILL;
+  }
+
+  return sendRequest(fmsnGetRespondType(msg->type));
+}
+
+RMSNRequest
+RMSNClient::willTopic(const char *willTopic, const bool update)
+{
+  // Answers to WILLTOPICREQ are built aside, mMessageBuffer still holds the
+  // CONNECT we may retransmit.
+  uint8_t  answer[RMSN_MAX_BUFFER_SIZE];
+  uint8_t *frame = update ? mMessageBuffer : answer;
+
+  if(update && !isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  if(willTopic == NULL)
+  {
+    RMSNMsgHeader *msg = reinterpret_cast<RMSNMsgHeader *>(frame);
+
+    msg->type   = update ? RMSNMT_WILLTOPICUPD : RMSNMT_WILLTOPIC;
+    msg->length = sizeof(RMSNMsgHeader);
+  }
+  else
+  {
+    RMSNMsgWillTopic *msg = reinterpret_cast<RMSNMsgWillTopic *>(frame);
+
+    msg->type  = update ? RMSNMT_WILLTOPICUPD : RMSNMT_WILLTOPIC;
+    msg->flags = mFlags & (RMSN_QOS_MASK | RMSN_FLAG_RETAIN);
+    fmsnSafeCopyText(msg->willTopic, willTopic,
+                     RMSN_GET_MAX_DATA_SIZE(RMSNMsgWillTopic));
+    msg->length = static_cast<uint8_t>(sizeof(RMSNMsgWillTopic)
+                                       + strlen(msg->willTopic));
+  }
+
+  if(update)
+  {
+    return sendRequest(fmsnGetRespondType(RMSNMT_WILLTOPICUPD));
+  }
+
+  writeMessage(reinterpret_cast<RMSNMsgHeader *>(answer));
+  return RMSNRequest();
+}
+
+RMSNRequest
+RMSNClient::willMsg(const void *willMsg, const uint8_t willMsgLen,
+                    const bool update)
+{
+  uint8_t  answer[RMSN_MAX_BUFFER_SIZE];
+  uint8_t *frame  = update ? mMessageBuffer : answer;
+  uint8_t  length = willMsgLen;
+
+  if(update && !isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  if(length > RMSN_GET_MAX_DATA_SIZE(RMSNMsgWillMsg))
+  {
+    length = RMSN_GET_MAX_DATA_SIZE(RMSNMsgWillMsg);
+  }
+
+  RMSNMsgWillMsg *msg = reinterpret_cast<RMSNMsgWillMsg *>(frame);
+
+  msg->length = sizeof(RMSNMsgWillMsg) + length;
+  msg->type   = update ? RMSNMT_WILLMSGUPD : RMSNMT_WILLMSG;
+  memcpy(msg->willmsg, willMsg, length);
+
+  if(update)
+  {
+    return sendRequest(fmsnGetRespondType(RMSNMT_WILLMSGUPD));
+  }
+
+  writeMessage(msg);
+  return RMSNRequest();
+}
+
+void
+RMSNClient::setWill(const RMSNWill *will)
+{
+  mWill = will;
+}
+
+const RMSNWill *
+RMSNClient::will() const
+{
+  return mWill;
+}
+
+RMSNRequest
+RMSNClient::disconnect(const uint16_t duration)
+{
+  if(!isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  // Given up before sending, so that neither the acknowledgement nor a
+  // timeout reconnects.
+  RMSNTimerWheel::instance()->cancel(&mReconnectTimer);
+  mRebuild.cancel();
+  mConnectionState = RMSN_CONNECTION_DISCONNECTED;
+
+  RMSNMsgDisconnect *msg =
+    reinterpret_cast<RMSNMsgDisconnect *>(mMessageBuffer);
+
+  msg->length = sizeof(RMSNMsgHeader);
+  msg->type   = RMSNMT_DISCONNECT;
+
+  if(duration > 0)
+  {
+    msg->length  += sizeof(RMSNMsgDisconnect);
+    msg->duration = rHtons(duration);
+  }
+
+  return sendRequest(fmsnGetRespondType(msg->type));
+}
+
+void
+RMSNClient::startResponseTimer()
+{
+  mResponseRetries = RMSN_N_RETRY;
+  RMSNTimerWheel::instance()->arm(&mResponseTimer, RMSN_T_RETRY * 1000L);
+}
+
+RMSNRequest
+RMSNClient::registerTopic(const char *name)
+{
+  if((RMSNMT_INVALID == mResponseToWaitFor)
+     && (mTopicCount < RMSN_MAX_TOPICS)
+     && isRequestFrameFree())
+  {
+    ++mMessageId;
+
+    // Fill in the next table entry, but we only increment the counter to
+    // the next topic when we get a REGACK from the broker. So don't issue
+    // another REGISTER until we have resolved this one.
+    setTopic(name, 0);
+
+    const RMSNTopic *topic = getTopicByName(name);
+
+    if(topic)
+    {
+      mRegisteredTopics |= 1U << (topic - mTopicTable);
+    }
+
+    RMSNMsgRegister *msg = reinterpret_cast<RMSNMsgRegister *>(mMessageBuffer);
+
+    encodeRegister(msg, name, mMessageId);
+
+    return sendRequest(fmsnGetRespondType(msg->type));
+  }
+
+  return RMSNRequest();
+}
+
+void
+RMSNClient::encodeRegister(RMSNMsgRegister *msg, const char *name,
+                           const uint16_t messageId)
+{
+  msg->length    = sizeof(RMSNMsgRegister) + strlen(name);
+  msg->type      = RMSNMT_REGISTER;
+  msg->topicId   = 0;
+  msg->messageId = rHtons(messageId);
+  fmsnSafeCopyText(msg->topicName, name,
+                   RMSN_GET_MAX_DATA_SIZE(RMSNMsgRegister));
+}
+
+void
+RMSNClient::regAck(const uint16_t topicId, const uint16_t messageId,
+                   const RMSNReturnCode returnCode)
+{
+  // Acknowledgements are sent from the stack, the request frame we may be
+  // waiting a response for must survive for retransmission.
+  RMSNMsgRegAck msg;
+
+  msg.length     = sizeof(RMSNMsgRegAck);
+  msg.type       = fmsnGetRespondType(RMSNMT_REGISTER);
+  msg.topicId    = rHtons(topicId);
+  msg.messageId  = rHtons(messageId);
+  msg.returnCode = returnCode;
+
+  writeMessage(&msg);
 }
 
-void
-MQTTSN::pubcompHandler(const msg_pubqos2 *msg)
+RMSNRequest
+RMSNClient::publish(const uint16_t topicId, const void *data,
+                    const uint8_t dataLen)
 {
+  RMSNPublisher publisher = publish(topicId);
+
+  if(!publisher.isValid())
+  {
+    return RMSNRequest();
+  }
+
+  publisher.payloadStream()->write(reinterpret_cast<const uint8_t *>(data),
+                                   dataLen);
+
+  // Committed when the publisher goes out of scope, after this.
+  return publisher.request();
 }
 
-#endif
+#ifdef USE_QOS2
+void
+MQTTSN::pubrec()
+{
+  msg_pubqos2 *msg = reinterpret_cast<msg_pubqos2 *>(message_buffer);
+
+  msg->length    = sizeof(msg_pubqos2);
+  msg->type      = PUBREC;
+  msg->messageId = bswap(_message_id);
+
+  send_message();
+}
 
 void
-RMSNClient::pingReqHandler(const RMSNMsgPingReq *msg)
+MQTTSN::pubrel()
 {
-  pingResp();
+  msg_pubqos2 *msg = reinterpret_cast<msg_pubqos2 *>(message_buffer);
+
+  msg->length    = sizeof(msg_pubqos2);
+  msg->type      = PUBREL;
+  msg->messageId = bswap(_message_id);
+
+  send_message();
 }
 
 void
-RMSNClient::subAckHandler(const RMSNMsgSubAck *msg)
+MQTTSN::pubcomp()
 {
+  msg_pubqos2 *msg = reinterpret_cast<msg_pubqos2 *>(message_buffer);
+
+  msg->length    = sizeof(msg_pubqos2);
+  msg->type      = PUBCOMP;
+  msg->messageId = bswap(_message_id);
+
+  send_message();
 }
 
+#endif
+
 void
-RMSNClient::unsubAckHandler(const RMSNMsgUnsubAck *msg)
+RMSNClient::pubAck(const uint16_t topicId, const uint16_t messageId,
+                   const RMSNReturnCode returnCode)
+{
+  RMSNMsgPubAck msg;
+
+  msg.length     = sizeof(RMSNMsgPubAck);
+  msg.type       = fmsnGetRespondType(RMSNMT_PUBLISH);
+  msg.topicId    = rHtons(topicId);
+  msg.messageId  = rHtons(messageId);
+  msg.returnCode = returnCode;
+
+  writeMessage(&msg);
+}
+
+RMSNRequest
+RMSNClient::subscribeByName(const char *topicName)
+{
+  if(!isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  ++mMessageId;
+
+  RMSNMsgSubscribe *msg = reinterpret_cast<RMSNMsgSubscribe *>(mMessageBuffer);
+
+  encodeSubscribe(msg, topicName, 0, qos() | RMSN_FLAG_TOPIC_NAME, mMessageId);
+  addSubscription(topicName, 0, msg->flags);
+
+  // Gateways answer at every QoS, the SUBACK carries the topic id.
+  return sendRequest(fmsnGetRespondType(msg->type));
+}
+
+RMSNRequest
+RMSNClient::subscribeById(const uint16_t topicId)
+{
+  if(!isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  ++mMessageId;
+
+  RMSNMsgSubscribe *msg = reinterpret_cast<RMSNMsgSubscribe *>(mMessageBuffer);
+
+  encodeSubscribe(msg, NULL, topicId, qos() | RMSN_FLAG_TOPIC_PREDEFINED_ID,
+                  mMessageId);
+  addSubscription(NULL, topicId, msg->flags);
+
+  return sendRequest(fmsnGetRespondType(msg->type));
+}
+
+RMSNRequest
+RMSNClient::subscribeBatch(const char *const *topicNames, const uint8_t count,
+                           uint8_t *grantedQos)
 {
+  if(mBatch.isActive() || (0 == count) || (count > RMSN_MAX_BATCH_TOPICS))
+  {
+    return RMSNRequest();
+  }
+
+  // Every topic must be remembered, or it would silently not be renewed
+  // after a reconnection.
+  uint8_t room = RMSN_MAX_SUBSCRIPTIONS - mSubscriptionCount;
+
+  for(uint8_t i = 0; i < count; ++i)
+  {
+    if(findSubscriptionName(topicNames[i], strlen(topicNames[i])))
+    {
+      ++room;
+    }
+  }
+
+  if(count > room)
+  {
+    return RMSNRequest();
+  }
+
+  const uint8_t id = beginRequest();
+
+  if(0 == id)
+  {
+    return RMSNRequest();
+  }
+
+  mBatchTopics  = topicNames;
+  mBatchGranted = grantedQos;
+  mBatchRequest = id;
+  mBatchResult  = RMSNRR_ACCEPTED;
+
+  for(uint8_t i = 0; i < count; ++i)
+  {
+    grantedQos[i] = RMSN_SUBSCRIBE_REJECTED;
+    addSubscription(topicNames[i], 0, qos() | RMSN_FLAG_TOPIC_NAME);
+  }
+
+  // The batch takes a message id range of its own.
+  const uint16_t messageId = mMessageId + 1;
+
+  mMessageId += count;
+  mBatch.start(count, messageId);
+
+  return RMSNRequest(this, id);
 }
 
 void
-RMSNClient::disconnectHandler(const RMSNMsgDisconnect *msg)
+RMSNClient::encodeSubscribe(RMSNMsgSubscribe *msg, const char *topicName,
+                            const uint16_t topicId, const uint8_t flags,
+                            const uint16_t messageId)
 {
+  msg->type      = RMSNMT_SUBSCRIBE;
+  msg->flags     = flags;
+  msg->messageId = rHtons(messageId);
+
+  if(topicName)
+  {
+    // The -2 here is because we're unioning a 0-length member (topicName)
+    // with a uint16_t in the msg_subscribe struct.
+    msg->length = sizeof(RMSNMsgSubscribe)
+                  + static_cast<uint8_t>(strlen(topicName) - 2);
+    fmsnSafeCopyText(msg->topicName, topicName, RMSN_GET_MAX_DATA_SIZE(
+                       RMSNMsgSubscribe) - 2);
+  }
+  else
+  {
+    msg->length  = sizeof(RMSNMsgSubscribe);
+    msg->topicId = rHtons(topicId);
+  }
 }
 
 void
-RMSNClient::pingRespHandler()
+RMSNClient::addSubscription(const char *topicName, const uint16_t topicId,
+                            const uint8_t flags)
+{
+  removeSubscription(topicName, topicId);
+
+  if(mSubscriptionCount >= RMSN_MAX_SUBSCRIPTIONS)
+  {
+    // Not renewed after a reconnection.
+    return;
+  }
+
+  Subscription &subscription = mSubscriptions[mSubscriptionCount++];
+
+  subscription.name    = topicName;
+  subscription.topicId = topicId;
+  subscription.flags   = flags;
+}
+
+const char *
+RMSNClient::findSubscriptionName(const char *topicName,
+                                 const uint8_t nameLen) const
 {
+  for(uint8_t i = 0; i < mSubscriptionCount; ++i)
+  {
+    const char *name = mSubscriptions[i].name;
+
+    if(name && (strncmp(name, topicName, nameLen) == 0)
+       && (0 == name[nameLen]))
+    {
+      return name;
+    }
+  }
+
+  return NULL;
 }
 
 void
-RMSNClient::publishHandler(const RMSNMsgPublish *msg)
+RMSNClient::removeSubscription(const char *topicName, const uint16_t topicId)
 {
-  if(msg->flags & RMSN_FLAG_QOS_1)
+  for(uint8_t i = 0; i < mSubscriptionCount; ++i)
   {
-    RMSNReturnCode ret = RMSNRC_REJECTED_INVALID_TOPIC_ID;
+    const Subscription &subscription = mSubscriptions[i];
+    const bool          isSame       = topicName
+      ? (subscription.name && (strcmp(subscription.name, topicName) == 0))
+      : (!subscription.name && (subscription.topicId == topicId));
 
-    if(getTopicById(rNtohs(msg->topicId)))
+    if(isSame)
     {
-      ret = RMSNRC_ACCEPTED;
+      // Keep the order, subscriptions are renewed as they were made.
+      memmove(&mSubscriptions[i], &mSubscriptions[i + 1],
+              (mSubscriptionCount - i - 1) * sizeof(Subscription));
+      --mSubscriptionCount;
+      return;
     }
+  }
+}
+
+RMSNRequest
+RMSNClient::unsubscribeByName(const char *topicName)
+{
+  if(!isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  ++mMessageId;
+
+  // Without acknowledgement it's built aside, mMessageBuffer may hold a
+  // request still waiting for its response.
+  uint8_t             aside[RMSN_MAX_BUFFER_SIZE];
+  const bool          isAcked = fmsnIsHighQos(qos());
+  RMSNMsgUnsubscribe *msg     = reinterpret_cast<RMSNMsgUnsubscribe *>(
+    isAcked ? mMessageBuffer : aside);
+
+  // The -2 here is because we're unioning a 0-length member (topicName)
+  // with a uint16_t in the msg_unsubscribe struct.
+  msg->length = sizeof(RMSNMsgUnsubscribe)
+                + static_cast<uint8_t>(strlen(topicName) - 2);
+  msg->type      = RMSNMT_UNSUBSCRIBE;
+  msg->flags     = qos() | RMSN_FLAG_TOPIC_NAME;
+  msg->messageId = rHtons(mMessageId);
+  fmsnSafeCopyText(msg->topicName, topicName,
+                   RMSN_GET_MAX_DATA_SIZE(RMSNMsgUnsubscribe) - 2);
+  removeSubscription(topicName, 0);
+
+  if(isAcked)
+  {
+    return sendRequest(fmsnGetRespondType(msg->type));
+  }
+
+  return sendUnacked(msg);
+}
+
+RMSNRequest
+RMSNClient::unsubscribeById(const uint16_t topicId)
+{
+  if(!isRequestFrameFree())
+  {
+    return RMSNRequest();
+  }
+
+  ++mMessageId;
+
+  uint8_t             aside[RMSN_MAX_BUFFER_SIZE];
+  const bool          isAcked = fmsnIsHighQos(qos());
+  RMSNMsgUnsubscribe *msg     = reinterpret_cast<RMSNMsgUnsubscribe *>(
+    isAcked ? mMessageBuffer : aside);
+
+  msg->length    = sizeof(RMSNMsgUnsubscribe);
+  msg->type      = RMSNMT_UNSUBSCRIBE;
+  msg->flags     = qos() | RMSN_FLAG_TOPIC_PREDEFINED_ID;
+  msg->messageId = rHtons(mMessageId);
+  msg->topicId   = rHtons(topicId);
+  removeSubscription(NULL, topicId);
+
+  if(isAcked)
+  {
+    return sendRequest(fmsnGetRespondType(msg->type));
+  }
+
+  return sendUnacked(msg);
+}
 
-    pubAck(msg->topicId, msg->messageId, ret);
+RMSNRequest
+RMSNClient::pingReq(const char *clientId)
+{
+  if(!isRequestFrameFree())
+  {
+    return RMSNRequest();
   }
+
+  RMSNMsgPingReq *msg = reinterpret_cast<RMSNMsgPingReq *>(mMessageBuffer);
+
+  msg->length = sizeof(RMSNMsgPingReq) + static_cast<uint8_t>(strlen(clientId));
+  msg->type   = RMSNMT_PINGREQ;
+  fmsnSafeCopyText(msg->clientId, clientId,
+                   RMSN_GET_MAX_DATA_SIZE(RMSNMsgPingReq));
+
+  return sendRequest(fmsnGetRespondType(msg->type));
 }
 
 void
-RMSNClient::registerHandler(const RMSNMsgRegister *msg)
+RMSNClient::pingResp()
 {
-  RMSNReturnCode ret     = RMSNRC_REJECTED_INVALID_TOPIC_ID;
-  uint16_t       topicId = rNtohs(msg->topicId);
+  RMSNMsgHeader msg;
 
-  auto topic = getTopicByName(msg->topicName);
+  msg.length = sizeof(RMSNMsgHeader);
+  msg.type   = fmsnGetRespondType(RMSNMT_PINGREQ);
 
-  if(topic)
+  writeMessage(&msg);
+}
+
+void
+RMSNClient::onResponseTimerExpired(void *context)
+{
+  static_cast<RMSNClient *>(context)->onResponseTimerTimeout();
+}
+
+void
+RMSNClient::onResponseTimerTimeout()
+{
+  if(responseToWaitFor() == RMSNMT_INVALID)
   {
-    setTopic(msg->topicName, topicId);
+    return;
+  }
 
-    ret = RMSNRC_ACCEPTED;
+  if(mResponseRetries <= 0)
+  {
+#ifdef RMSN_USE_METRICS
+    ++mMetrics.timeouts;
+#endif
+
+    RMSN_TRACE(RMSNTE_TIMEOUT,
+               reinterpret_cast<RMSNMsgHeader *>(mRequestFrame));
+
+    timeout();
+    disconnectHandler(RMSNDisconnectView(NULL));
+
+    flushPublishes();
+    return;
   }
 
-  regAck(msg->topicId, msg->messageId, ret);
+#ifdef RMSN_USE_METRICS
+  ++mMetrics.retransmissions;
+#endif
+
+  RMSN_TRACE(RMSNTE_RETRY, reinterpret_cast<RMSNMsgHeader *>(mRequestFrame));
+
+  sendFrame(mRequestFrame);
+  --mResponseRetries;
+
+  RMSNTimerWheel::instance()->arm(&mResponseTimer, RMSN_T_RETRY * 1000L);
 }
 
 void
-RMSNClient::willTopicRespHandler(const RMSNMsgWillTopicResp *msg)
+RMSNClient::setAutoReconnect(const bool enabled)
+{
+  mIsAutoReconnect = enabled;
+
+  if(!enabled && (RMSN_CONNECTION_DISCONNECTED == mConnectionState))
+  {
+    RMSNTimerWheel::instance()->cancel(&mReconnectTimer);
+  }
+}
+
+bool
+RMSNClient::isAutoReconnect() const
+{
+  return mIsAutoReconnect;
+}
+
+bool
+RMSNClient::isConnected() const
 {
+  return RMSN_CONNECTION_CONNECTED == mConnectionState;
 }
 
 void
-RMSNClient::willMsgRespHandler(const RMSNMsgWillMsgResp *msg)
+RMSNClient::onReconnectTimerExpired(void *context)
 {
+  static_cast<RMSNClient *>(context)->onReconnectTimerTimeout();
 }
 
 void
-RMSNClient::searchGw(const uint8_t radius)
+RMSNClient::onReconnectTimerTimeout()
 {
-  RMSNMsgSearchGw *msg = reinterpret_cast<RMSNMsgSearchGw *>(mMessageBuffer);
+  if(RMSN_CONNECTION_DISCONNECTED == mConnectionState)
+  {
+    if(!connect())
+    {
+      // A publish still holds the request frame.
+      scheduleReconnect();
+    }
+  }
+}
 
-  msg->length = sizeof(RMSNMsgSearchGw);
-  msg->type   = RMSNMT_SEARCHGW;
-  msg->radius = radius;
+void
+RMSNClient::connectionLost()
+{
+  if(RMSN_CONNECTION_DISCONNECTED == mConnectionState)
+  {
+    return;
+  }
 
-  sendMessage();
-  mResponseToWaitFor = fmsnGetRespondType(msg->type);
+  if(RMSN_CONNECTION_CONNECTED == mConnectionState)
+  {
+    mIsSessionLost = true;
+    ++mSessionGeneration;
+#ifdef RMSN_USE_METRICS
+    mLostTime = millis();
+#endif
+  }
+
+  mConnectionState = RMSN_CONNECTION_DISCONNECTED;
+  mRebuild.cancel();
+
+  if(mBatch.isActive())
+  {
+    // Its topics are remembered already, the renewal subscribes them.
+    finishBatch(RMSNRR_CANCELLED);
+  }
+
+  RMSNTimerWheel::instance()->cancel(&mReconnectTimer);
+
+  if(mIsAutoReconnect)
+  {
+    scheduleReconnect();
+  }
 }
 
 void
-RMSNClient::connect()
+RMSNClient::scheduleReconnect()
 {
-  RMSNMsgConnect *msg = reinterpret_cast<RMSNMsgConnect *>(mMessageBuffer);
+  uint32_t delay = RMSN_RECONNECT_MAX_DELAY;
 
-  msg->length =
-    static_cast<uint8_t>(sizeof(RMSNMsgConnect) + mClientId.length());
-  msg->type       = RMSNMT_CONNECT;
-  msg->flags      = mFlags;
-  msg->protocolId = RMSN_PROTOCOL_ID;
-  msg->duration   = rHtons(mKeepAliveInterval);
+  if((mReconnectAttempts < 16)
+     && ((RMSN_RECONNECT_MIN_DELAY << mReconnectAttempts) < delay))
+  {
+    delay = RMSN_RECONNECT_MIN_DELAY << mReconnectAttempts;
+  }
 
-  fmsnSafeCopyText(msg->clientId, mClientId.c_str(),
-                   RMSN_GET_MAX_DATA_SIZE(RMSNMsgConnect));
+  // Somewhere in the second half of the delay, clients that lost the same
+  // gateway spread out instead of coming back together.
+  delay = delay / 2 + nextJitter() % (delay / 2 + 1);
 
-  sendMessage();
-  mResponseToWaitFor = fmsnGetRespondType(msg->type);
+  if(mReconnectAttempts < 0xFF)
+  {
+    ++mReconnectAttempts;
+  }
+
+  RMSNTimerWheel::instance()->arm(&mReconnectTimer, delay);
 }
 
 void
-RMSNClient::willTopic(const char *willTopic, const bool update)
+RMSNClient::startRebuild()
 {
-  if(willTopic == NULL)
+  uint8_t count = 0;
+
+  for(uint8_t i = 0; i < mTopicCount; ++i)
   {
-    RMSNMsgHeader *msg = reinterpret_cast<RMSNMsgHeader *>(mMessageBuffer);
-
-    msg->type   = update ? RMSNMT_WILLTOPICUPD : RMSNMT_WILLTOPIC;
-    msg->length = sizeof(RMSNMsgHeader);
+    if(mRegisteredTopics & (1U << i))
+    {
+      ++count;
+    }
   }
-  else
-  {
-    RMSNMsgWillTopic *msg =
-      reinterpret_cast<RMSNMsgWillTopic *>(mMessageBuffer);
 
-    msg->type  = update ? RMSNMT_WILLTOPICUPD : RMSNMT_WILLTOPIC;
-    msg->flags = mFlags;
-    fmsnSafeCopyText(msg->willTopic, willTopic,
-                     RMSN_GET_MAX_DATA_SIZE(RMSNMsgWillTopic));
+  mRebuildTopicCount = count;
+  count             += mSubscriptionCount;
+
+  if(0 == count)
+  {
+    finishRebuild();
+    return;
   }
 
-  sendMessage();
+  // The renewal takes a message id range of its own.
+  const uint16_t messageId = mMessageId + 1;
 
-//    if (qos() == RMSN_FLAG_QOS_1 || qos() == RMSN_FLAG_QOS_2) {
-//        waitingForResponse = true;
-//        responseToWaitFor = WILLMSGREQ;
-//    }
+  mMessageId += count;
+  mRebuild.start(count, messageId);
 }
 
 void
-RMSNClient::willMsg(const void *willMsg, const uint8_t willMsgLen,
-                    const bool update)
+RMSNClient::finishRebuild()
 {
-  RMSNMsgWillMsg *msg = reinterpret_cast<RMSNMsgWillMsg *>(mMessageBuffer);
+  // Topic ids are the renewed ones from now on, templates made while
+  // renewing are stale too.
+  ++mSessionGeneration;
 
-  msg->length = sizeof(RMSNMsgWillMsg) + willMsgLen;
-  msg->type   = update ? RMSNMT_WILLMSGUPD : RMSNMT_WILLMSG;
-  memcpy(msg->willmsg, willMsg, willMsgLen);
+  if(mValueCache)
+  {
+    // Names are bound again by the next value on their renewed ids.
+    mValueCache->unbindAll();
+  }
 
-  sendMessage();
+#ifdef RMSN_USE_METRICS
+  ++mMetrics.reconnects;
+  mMetrics.reconnectTime = millis() - mLostTime;
+#endif
+
+  reconnected.emit();
 }
 
 void
-RMSNClient::disconnect(const uint16_t duration)
+RMSNClient::sendRebuildFrame(void *context, uint8_t item, uint16_t messageId)
 {
-  RMSNMsgDisconnect *msg =
-    reinterpret_cast<RMSNMsgDisconnect *>(mMessageBuffer);
-
-  msg->length = sizeof(RMSNMsgHeader);
-  msg->type   = RMSNMT_DISCONNECT;
+  RMSNClient *self = static_cast<RMSNClient *>(context);
+  // Sent from the stack, the request frame must survive for retransmission.
+  uint8_t      frame[RMSN_MAX_BUFFER_SIZE];
+  const int8_t topicIndex = self->rebuildTopicIndex(item);
 
-  if(duration > 0)
+  if(topicIndex >= 0)
   {
-    msg->length  += sizeof(RMSNMsgDisconnect);
-    msg->duration = rHtons(duration);
+    self->encodeRegister(reinterpret_cast<RMSNMsgRegister *>(frame),
+                         self->mTopicTable[topicIndex].name, messageId);
+  }
+  else
+  {
+    const Subscription &subscription =
+      self->mSubscriptions[item - self->mRebuildTopicCount];
+
+    self->encodeSubscribe(reinterpret_cast<RMSNMsgSubscribe *>(frame),
+                          subscription.name, subscription.topicId,
+                          subscription.flags, messageId);
   }
 
-  sendMessage();
-  mResponseToWaitFor = fmsnGetRespondType(msg->type);
+  self->writeMessage(reinterpret_cast<RMSNMsgHeader *>(frame));
 }
 
 void
-RMSNClient::startResponseTimer()
+RMSNClient::onRebuildTimeout(void *context)
 {
-  mResponseRetries = RMSN_N_RETRY;
-  mResponseTimer.start();
+  // The gateway is not answering again.
+  static_cast<RMSNClient *>(context)->connectionLost();
 }
 
-bool
-RMSNClient::registerTopic(const char *name)
+int8_t
+RMSNClient::rebuildTopicIndex(uint8_t item) const
 {
-  if((RMSNMT_INVALID == mResponseToWaitFor)
-     && (mTopicCount < RMSN_MAX_TOPICS))
+  if(item >= mRebuildTopicCount)
   {
-    ++mMessageId;
-
-    // Fill in the next table entry, but we only increment the counter to
-    // the next topic when we get a REGACK from the broker. So don't issue
-    // another REGISTER until we have resolved this one.
-    setTopic(name, 0);
-
-    RMSNMsgRegister *msg = reinterpret_cast<RMSNMsgRegister *>(mMessageBuffer);
-
-    msg->length    = sizeof(RMSNMsgRegister) + strlen(name);
-    msg->type      = RMSNMT_REGISTER;
-    msg->topicId   = 0;
-    msg->messageId = rHtons(mMessageId);
-    fmsnSafeCopyText(msg->topicName, name,
-                     RMSN_GET_MAX_DATA_SIZE(RMSNMsgRegister));
+    return -1;
+  }
 
-    sendMessage();
-    mResponseToWaitFor = fmsnGetRespondType(msg->type);
-    return true;
+  for(uint8_t i = 0; i < mTopicCount; ++i)
+  {
+    if((mRegisteredTopics & (1U << i)) && (0 == item--))
+    {
+      return i;
+    }
   }
 
-  return false;
+  return -1;
 }
 
 void
-RMSNClient::regAck(const uint16_t topicId, const uint16_t messageId,
-                   const RMSNReturnCode returnCode)
+RMSNClient::sendBatchFrame(void *context, uint8_t item, uint16_t messageId)
 {
-  RMSNMsgRegAck *msg = reinterpret_cast<RMSNMsgRegAck *>(mMessageBuffer);
-
-  msg->length     = sizeof(RMSNMsgRegAck);
-  msg->type       = fmsnGetRespondType(RMSNMT_REGISTER);
-  msg->topicId    = rHtons(topicId);
-  msg->messageId  = rHtons(messageId);
-  msg->returnCode = returnCode;
+  RMSNClient *self = static_cast<RMSNClient *>(context);
+  // Sent from the stack, the request frame must survive for retransmission.
+  uint8_t     frame[RMSN_MAX_BUFFER_SIZE];
+
+  self->encodeSubscribe(reinterpret_cast<RMSNMsgSubscribe *>(frame),
+                        self->mBatchTopics[item], 0,
+                        self->qos() | RMSN_FLAG_TOPIC_NAME, messageId);
+  self->writeMessage(reinterpret_cast<RMSNMsgHeader *>(frame));
+}
 
-  sendMessage();
+void
+RMSNClient::onBatchTimeout(void *context)
+{
+  static_cast<RMSNClient *>(context)->finishBatch(RMSNRR_TIMEOUT);
 }
 
 void
-RMSNClient::publish(const uint16_t topicId, const void *data,
-                    const uint8_t dataLen)
+RMSNClient::finishBatch(const RMSNRequestResult result)
 {
-  ++mMessageId;
+  mBatch.cancel();
+  mBatchTopics = NULL;
 
-  RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(mMessageBuffer);
+  completeRequest(mBatchRequest, result);
+}
 
-  msg->length = sizeof(RMSNMsgPublish) + dataLen;
-  msg->type   = RMSNMT_PUBLISH;
+uint32_t
+RMSNClient::nextJitter()
+{
+  if(0 == mJitterState)
+  {
+    // Seeded per client, the default random() sequence is the same on
+    // every device.
+    mJitterState = 2166136261UL ^ micros();
 
-  msg->flags = mFlags;
+    for(const char *c = mClientId; *c; ++c)
+    {
+      mJitterState = (mJitterState ^ static_cast<uint8_t>(*c)) * 16777619UL;
+    }
 
-  if(qos() == RMSN_FLAG_QOS_M1)
-  {
-    msg->flags |= RMSN_FLAG_TOPIC_PREDEFINED_ID;
+    if(0 == mJitterState)
+    {
+      mJitterState = 1;
+    }
   }
 
-  msg->topicId   = rHtons(topicId);
-  msg->messageId = rHtons(mMessageId);
-  memcpy(msg->data, data, dataLen);
-
-  sendMessage();
+  // xorshift32
+  mJitterState ^= mJitterState << 13;
+  mJitterState ^= mJitterState >> 17;
+  mJitterState ^= mJitterState << 5;
 
-  if(fmsnIsHighQos(qos()))
-  {
-    mResponseToWaitFor = fmsnGetRespondType(RMSNMT_PUBLISH);
-  }
+  return mJitterState;
 }
 
-#ifdef USE_QOS2
 void
-MQTTSN::pubrec()
+RMSNClient::setCodec(RMSNCodec *codec)
 {
-  msg_pubqos2 *msg = reinterpret_cast<msg_pubqos2 *>(message_buffer);
-
-  msg->length    = sizeof(msg_pubqos2);
-  msg->type      = PUBREC;
-  msg->messageId = bswap(_message_id);
-
-  send_message();
+  mCodec = codec;
 }
 
-void
-MQTTSN::pubrel()
+RMSNCodec *
+RMSNClient::codec() const
 {
-  msg_pubqos2 *msg = reinterpret_cast<msg_pubqos2 *>(message_buffer);
-
-  msg->length    = sizeof(msg_pubqos2);
-  msg->type      = PUBREL;
-  msg->messageId = bswap(_message_id);
-
-  send_message();
+  return mCodec;
 }
 
 void
-MQTTSN::pubcomp()
+RMSNClient::setValueCache(RMSNValueCache *cache)
 {
-  msg_pubqos2 *msg = reinterpret_cast<msg_pubqos2 *>(message_buffer);
-
-  msg->length    = sizeof(msg_pubqos2);
-  msg->type      = PUBCOMP;
-  msg->messageId = bswap(_message_id);
-
-  send_message();
+  mValueCache = cache;
 }
 
-#endif
-
-void
-RMSNClient::pubAck(const uint16_t topicId, const uint16_t messageId,
-                   const RMSNReturnCode returnCode)
+RMSNValueCache *
+RMSNClient::valueCache() const
 {
-  RMSNMsgPubAck *msg = reinterpret_cast<RMSNMsgPubAck *>(mMessageBuffer);
+  return mValueCache;
+}
 
-  msg->length     = sizeof(RMSNMsgPubAck);
-  msg->type       = fmsnGetRespondType(RMSNMT_PUBLISH);
-  msg->topicId    = rHtons(topicId);
-  msg->messageId  = rHtons(messageId);
-  msg->returnCode = returnCode;
+uint8_t
+RMSNClient::maxPublishDataSize(const uint16_t topicId) const
+{
+  if(mCodec && mCodec->hasTopic(topicId))
+  {
+    return RMSN_CODEC_MAX_VALUE_SIZE;
+  }
 
-  sendMessage();
+  return RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish);
 }
 
-void
-RMSNClient::subscribeByName(const char *topicName)
+uint8_t
+RMSNClient::encodePayload(const uint16_t topicId, char *data,
+                          const uint8_t dataLen)
 {
-  ++mMessageId;
+  if(NULL == mCodec)
+  {
+    return dataLen;
+  }
 
-  RMSNMsgSubscribe *msg = reinterpret_cast<RMSNMsgSubscribe *>(mMessageBuffer);
+  return mCodec->encode(topicId, reinterpret_cast<uint8_t *>(data), dataLen,
+                        RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish));
+}
 
-  // The -2 here is because we're unioning a 0-length member (topicName)
-  // with a uint16_t in the msg_subscribe struct.
-  msg->length = sizeof(RMSNMsgSubscribe)
-                + static_cast<uint8_t>(strlen(topicName) - 2);
-  msg->type      = RMSNMT_SUBSCRIBE;
-  msg->flags     = qos() | RMSN_FLAG_TOPIC_NAME;
-  msg->messageId = rHtons(mMessageId);
-  fmsnSafeCopyText(msg->topicName, topicName, RMSN_GET_MAX_DATA_SIZE(
-                     RMSNMsgSubscribe) - 2);
+RMSNPublisher
+RMSNClient::publish(const uint16_t topicId)
+{
+  return publish(topicId, qos());
+}
 
-  sendMessage();
+RMSNPublisher
+RMSNClient::publish(const uint16_t topicId, const uint8_t qos)
+{
+  int8_t slot = acquirePublishSlot();
 
-  if(fmsnIsHighQos(qos()))
+  if(slot < 0)
   {
-    mResponseToWaitFor = fmsnGetRespondType(msg->type);
+    // All frames are in use, the publish is dropped.
+    return RMSNPublisher(NULL, 0, NULL, 0);
   }
-}
 
-void
-RMSNClient::subscribeById(const uint16_t topicId)
-{
   ++mMessageId;
 
-  RMSNMsgSubscribe *msg = reinterpret_cast<RMSNMsgSubscribe *>(mMessageBuffer);
+  RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(publishFrame(slot));
 
-  msg->length    = sizeof(RMSNMsgSubscribe);
-  msg->type      = RMSNMT_SUBSCRIBE;
-  msg->flags     = qos() | RMSN_FLAG_TOPIC_PREDEFINED_ID;
+  encodePublishHeader(msg, topicId, qos);
   msg->messageId = rHtons(mMessageId);
-  msg->topicId   = rHtons(topicId);
-
-  sendMessage();
 
-  if(fmsnIsHighQos(qos()))
-  {
-    mResponseToWaitFor = fmsnGetRespondType(msg->type);
-  }
+  return RMSNPublisher(this, slot, reinterpret_cast<uint8_t *>(msg->data),
+                       maxPublishDataSize(topicId));
 }
 
-void
-RMSNClient::unsubscribeByName(const char *topicName)
+RMSNPublishTemplate
+RMSNClient::publishTemplate(const uint16_t topicId, const uint8_t qos) const
 {
-  ++mMessageId;
+  RMSNPublishTemplate publishTemplate;
 
-  RMSNMsgUnsubscribe *msg =
-    reinterpret_cast<RMSNMsgUnsubscribe *>(mMessageBuffer);
+  encodePublishHeader(&publishTemplate.mHeader, topicId, qos);
+  publishTemplate.mMaxDataSize = maxPublishDataSize(topicId);
+  publishTemplate.mGeneration  = mSessionGeneration;
 
-  // The -2 here is because we're unioning a 0-length member (topicName)
-  // with a uint16_t in the msg_unsubscribe struct.
-  msg->length = sizeof(RMSNMsgUnsubscribe)
-                + static_cast<uint8_t>(strlen(topicName) - 2);
-  msg->type      = RMSNMT_UNSUBSCRIBE;
-  msg->flags     = qos() | RMSN_FLAG_TOPIC_NAME;
-  msg->messageId = rHtons(mMessageId);
-  fmsnSafeCopyText(msg->topicName, topicName,
-                   RMSN_GET_MAX_DATA_SIZE(RMSNMsgUnsubscribe) - 2);
+  return publishTemplate;
+}
 
-  sendMessage();
+RMSNPublisher
+RMSNClient::publish(const RMSNPublishTemplate &publishTemplate)
+{
+  int8_t slot = -1;
 
-  if(fmsnIsHighQos(qos()))
+  if(publishTemplate.isValid()
+     && (publishTemplate.mGeneration == mSessionGeneration))
   {
-    mResponseToWaitFor = fmsnGetRespondType(msg->type);
+    slot = acquirePublishSlot();
   }
-}
 
-void
-RMSNClient::unsubscribeById(const uint16_t topicId)
-{
-  ++mMessageId;
+  if(slot < 0)
+  {
+    return RMSNPublisher(NULL, 0, NULL, 0);
+  }
 
-  RMSNMsgUnsubscribe *msg =
-    reinterpret_cast<RMSNMsgUnsubscribe *>(mMessageBuffer);
+  RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(publishFrame(slot));
 
-  msg->length    = sizeof(RMSNMsgUnsubscribe);
-  msg->type      = RMSNMT_UNSUBSCRIBE;
-  msg->flags     = qos() | RMSN_FLAG_TOPIC_PREDEFINED_ID;
-  msg->messageId = rHtons(mMessageId);
-  msg->topicId   = rHtons(topicId);
+  memcpy(msg, &publishTemplate.mHeader, sizeof(RMSNMsgPublish));
+  msg->messageId = rHtons(++mMessageId);
 
-  sendMessage();
+  return RMSNPublisher(this, slot, reinterpret_cast<uint8_t *>(msg->data),
+                       publishTemplate.mMaxDataSize);
+}
+
+RMSNRequest
+RMSNClient::publish(const RMSNPublishTemplate &publishTemplate,
+                    const void *data, const uint8_t dataLen)
+{
+  RMSNPublisher publisher = publish(publishTemplate);
 
-  if(fmsnIsHighQos(qos()))
+  if(!publisher.isValid())
   {
-    mResponseToWaitFor = fmsnGetRespondType(msg->type);
+    return RMSNRequest();
   }
+
+  publisher.payloadStream()->write(reinterpret_cast<const uint8_t *>(data),
+                                   dataLen);
+
+  // Committed when the publisher goes out of scope, after this.
+  return publisher.request();
 }
 
 void
-RMSNClient::pingReq(const char *clientId)
+RMSNClient::encodePublishHeader(RMSNMsgPublish *msg, const uint16_t topicId,
+                                const uint8_t qos) const
 {
-  RMSNMsgPingReq *msg = reinterpret_cast<RMSNMsgPingReq *>(mMessageBuffer);
-
-  msg->length = sizeof(RMSNMsgPingReq) + static_cast<uint8_t>(strlen(clientId));
-  msg->type   = RMSNMT_PINGREQ;
-  fmsnSafeCopyText(msg->clientId, clientId,
-                   RMSN_GET_MAX_DATA_SIZE(RMSNMsgPingReq));
+  // Data length will be append in the publishEnd()
+  msg->length = sizeof(RMSNMsgPublish);
+  msg->type   = RMSNMT_PUBLISH;
+  msg->flags  = (mFlags & ~RMSN_QOS_MASK) | (qos & RMSN_QOS_MASK);
 
-  sendMessage();
+  if((qos & RMSN_QOS_MASK) == RMSN_FLAG_QOS_M1)
+  {
+    msg->flags |= RMSN_FLAG_TOPIC_PREDEFINED_ID;
+  }
 
-  mResponseToWaitFor = fmsnGetRespondType(msg->type);
+  msg->topicId = rHtons(topicId);
 }
 
 void
-RMSNClient::pingResp()
+RMSNClient::publishEnd(const uint8_t slot, const uint8_t dataLen)
 {
-  RMSNMsgHeader *msg = reinterpret_cast<RMSNMsgHeader *>(mMessageBuffer);
+  RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(publishFrame(slot));
 
-  msg->length = sizeof(RMSNMsgHeader);
-  msg->type   = fmsnGetRespondType(RMSNMT_PINGREQ);
+  msg->length            += dataLen;
+  mPublishSlotStates[slot] = RMSN_PUBLISH_SLOT_READY;
 
-  sendMessage();
+  flushPublishes();
 }
 
-void
-RMSNClient::onResponseTimerTimeout()
+uint8_t *
+RMSNClient::publishFrame(const uint8_t slot)
 {
-  if(responseToWaitFor() == RMSNMT_INVALID)
+#if RMSN_PUBLISH_POOL_SIZE > 1
+  if(slot > 0)
   {
-    mResponseTimer.stop();
-    return;
+    return mPublishFrames[slot - 1];
   }
+#else
+  (void)slot;
+#endif
 
-  if(mResponseRetries <= 0)
-  {
-    timeout();
-    disconnectHandler(NULL);
-
-    mResponseTimer.stop();
-    return;
-  }
+  return mMessageBuffer;
+}
 
-  sendMessage();
-  --mResponseRetries;
+bool
+RMSNClient::isRequestFrameFree() const
+{
+  // A request would cancel the publish waiting for its PUBACK.
+  return (RMSN_PUBLISH_SLOT_FREE == mPublishSlotStates[0])
+         && (RMSNMT_PUBACK != mResponseToWaitFor);
 }
 
-RMSNPublisher
-RMSNClient::publish(const uint16_t topicId)
+int8_t
+RMSNClient::acquirePublishSlot()
 {
-  ++mMessageId;
+  // Prefer the dedicated frames, mMessageBuffer is shared with all other
+  // requests.
+  for(int8_t slot = RMSN_PUBLISH_POOL_SIZE - 1; slot >= 0; --slot)
+  {
+    if(RMSN_PUBLISH_SLOT_FREE != mPublishSlotStates[slot])
+    {
+      continue;
+    }
 
-  RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(mMessageBuffer);
+    if((0 == slot)
+       && (RMSNMT_INVALID != mResponseToWaitFor)
+       && (mRequestFrame == mMessageBuffer))
+    {
+      // Holds a request we may need to retransmit.
+      continue;
+    }
 
-  // Data length will be append in the publishEnd()
-  msg->length = sizeof(RMSNMsgPublish);
-  msg->type   = RMSNMT_PUBLISH;
-  msg->flags  = mFlags;
+    mPublishSlotStates[slot]            = RMSN_PUBLISH_SLOT_BUILDING;
+    mPublishRequests[slot]              = beginRequest();
+    mPublishOrder[mPublishOrderCount++] = slot;
 
-  if(qos() == RMSN_FLAG_QOS_M1)
-  {
-    msg->flags |= RMSN_FLAG_TOPIC_PREDEFINED_ID;
+    return slot;
   }
 
-  msg->topicId   = rHtons(topicId);
-  msg->messageId = rHtons(mMessageId);
-
-  mPubPayloadStream.reset();
-
-  return RMSNPublisher(this);
+  return -1;
 }
 
 void
-RMSNClient::publishEnd()
+RMSNClient::flushPublishes()
 {
-  RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(mMessageBuffer);
+  while(mPublishOrderCount > 0)
+  {
+    const uint8_t slot  = mPublishOrder[0];
+    uint8_t      &state = mPublishSlotStates[slot];
+
+    if(RMSN_PUBLISH_SLOT_BUILDING == state)
+    {
+      // Publishes are committed in the order they were started.
+      return;
+    }
+
+    if(RMSN_PUBLISH_SLOT_READY == state)
+    {
+      if(RMSNMT_INVALID != mResponseToWaitFor)
+      {
+        return;
+      }
 
-  msg->length += mPubPayloadStream.available();
+      RMSNMsgPublish *msg =
+        reinterpret_cast<RMSNMsgPublish *>(publishFrame(slot));
 
-  sendMessage();
+      msg->length = sizeof(RMSNMsgPublish)
+                    + encodePayload(rNtohs(msg->topicId), msg->data,
+                                    msg->length - sizeof(RMSNMsgPublish));
 
-  if(fmsnIsHighQos(qos()))
-  {
-    mResponseToWaitFor = fmsnGetRespondType(RMSNMT_PUBLISH);
+      sendFrame(publishFrame(slot));
+
+      if(fmsnIsHighQos(msg->flags & RMSN_QOS_MASK))
+      {
+        mPendingRequest = mPublishRequests[slot];
+        setResponseToWaitFor(fmsnGetRespondType(RMSNMT_PUBLISH));
+        state = RMSN_PUBLISH_SLOT_SENT;
+        return;
+      }
+
+      state = RMSN_PUBLISH_SLOT_FREE;
+      --mPublishOrderCount;
+      memmove(mPublishOrder, mPublishOrder + 1, mPublishOrderCount);
+
+      // Nothing to wait for, done once sent. The callback may publish
+      // again, so the slot is released first.
+      completeRequest(mPublishRequests[slot], RMSNRR_ACCEPTED);
+      continue;
+    }
+    else if((RMSN_PUBLISH_SLOT_SENT == state)
+            && (RMSNMT_INVALID != mResponseToWaitFor))
+    {
+      // Still waiting for the PUBACK, keep the frame for retransmission.
+      return;
+    }
+
+    state = RMSN_PUBLISH_SLOT_FREE;
+    --mPublishOrderCount;
+    memmove(mPublishOrder, mPublishOrder + 1, mPublishOrderCount);
   }
 }
@@ -28,16 +28,77 @@
 
 #include "RMSNTypes.h"
 #include "RMSNPublisher.h"
-#include <RTimer.h>
+#include "RMSNView.h"
+#include "RMSNRequest.h"
+#include "RMSNPublishTemplate.h"
+#include "RMSNTimerWheel.h"
+#include "RMSNPipeline.h"
 #include <RSignal.h>
 #include <RBufferStream.h>
 
+#ifdef RMSN_USE_METRICS
+#include "RMSNMetrics.h"
+#endif
+
 #define RMSN_MAX_TOPICS      10
 #define RMSN_MAX_BUFFER_SIZE 66
 #define RMSN_GET_MAX_DATA_SIZE(headerClass) \
   ((size_t)(RMSN_MAX_BUFFER_SIZE - sizeof(headerClass)))
 #define RMSN_MAX_CLIENT_ID_LEN 23
+/// A length byte of this value is followed by a two bytes length.
+#define RMSN_EXTENDED_LENGTH 0x01
+/// Milliseconds to wait for the rest of a frame once its first byte came,
+/// the frame is dropped if it's not complete by then. A full frame takes
+/// about 70 ms at 9600 baud, raise it for slower links.
+#define RMSN_RX_FRAME_TIMEOUT 100
+#ifndef RMSN_PUBLISH_POOL_SIZE
+#ifdef RMSN_USE_SINGLE_BUFFER
+#define RMSN_PUBLISH_POOL_SIZE 1
+#else
+#define RMSN_PUBLISH_POOL_SIZE 2
+#endif
+#endif
+
+/// Requests whose results are remembered, enough for one request and a full
+/// publish pool.
+#define RMSN_MAX_REQUESTS (RMSN_PUBLISH_POOL_SIZE + 2)
 
+/// QoS 1 message ids received, behind the newest one, that are remembered
+/// to drop retransmissions. It's the width of mInboundWindow.
+#define RMSN_INBOUND_WINDOW 32
+
+/// Subscriptions remembered to be renewed after a reconnection, see
+/// RMSNConfig.h.
+#ifndef RMSN_MAX_SUBSCRIPTIONS
+#define RMSN_MAX_SUBSCRIPTIONS 8
+#endif
+/// Topics a batch subscribe could carry, each one is remembered.
+#define RMSN_MAX_BATCH_TOPICS RMSN_MAX_SUBSCRIPTIONS
+/// Granted QoS of a topic the gateway rejected
+#define RMSN_SUBSCRIBE_REJECTED 0xFF
+
+/// Milliseconds before the first reconnection attempt, doubled after each
+/// failed attempt up to RMSN_RECONNECT_MAX_DELAY.
+#define RMSN_RECONNECT_MIN_DELAY 1000L
+#define RMSN_RECONNECT_MAX_DELAY 60000L
+
+#define RMSN_CONNECTION_DISCONNECTED 0
+#define RMSN_CONNECTION_CONNECTING   1
+#define RMSN_CONNECTION_CONNECTED    2
+
+/// Only handled while we are waiting for this response type
+#define RMSN_DISPATCH_RESPONSE 0x01
+
+#define RMSN_PUBLISH_SLOT_FREE     0
+#define RMSN_PUBLISH_SLOT_BUILDING 1
+#define RMSN_PUBLISH_SLOT_READY    2
+/// Sent and waiting for the PUBACK
+#define RMSN_PUBLISH_SLOT_SENT     3
+
+class RMSNCodec;
+class RMSNSubmitQueue;
+class RMSNWill;
+class RMSNValueCache;
 class RMSNClient : public RObject
 {
 public:
@@ -67,16 +128,98 @@ public:
   void
   parseStream();
 
+  /**
+   * @brief Only read the stream after notifyReadable()
+   *
+   * By default the stream is polled on every idle loop of the event loop.
+   * In readiness driven mode the idle loop only checks a flag set by
+   * notifyReadable(), typically from serialEvent() or a UART receive
+   * interrupt, and then drains all the frames available:
+   *
+   * @code
+   * void
+   * serialEvent3()
+   * {
+   *   client->notifyReadable();
+   * }
+   * @endcode
+   *
+   * Between frames the sketch may then sleep until the receive interrupt or
+   * the next retransmission, see RMSNTimerWheel::nextDeadline().
+   */
   void
-  searchGw(const uint8_t radius);
+  setReadinessDriven(const bool enabled);
+  bool
+  isReadinessDriven() const;
+  /// Safe to call from an interrupt handler.
   void
-  connect();
+  notifyReadable();
+
+  /**
+   * @brief Send the publishes queued in queue from the idle loop
+   *
+   * Publishes submitted to the queue, from interrupt handlers for example,
+   * go through the publish frame pool like the others. NULL to detach.
+   */
   void
-  willTopic(const char *willTopic, const bool update=false);
+  setSubmitQueue(RMSNSubmitQueue *queue);
+
+  // Requests are built in the first publish frame, they are refused with an
+  // invalid RMSNRequest while a publish is in there. See
+  // RMSN_PUBLISH_POOL_SIZE.
   void
+  searchGw(const uint8_t radius);
+  RMSNRequest
+  connect();
+  /**
+   * @brief Send a will topic by hand
+   *
+   * Without update it answers a WILLTOPICREQ and the returned request is
+   * invalid; prefer setWill(), which answers automatically. With update it
+   * waits for the WILLTOPICRESP.
+   */
+  RMSNRequest
+  willTopic(const char *willTopic, const bool update=false);
+  /// @see willTopic()
+  RMSNRequest
   willMsg(const void *willMsg, const uint8_t willMsgLen,
           const bool update=false);
+
+  /**
+   * @brief Set the will announced by connect()
+   *
+   * The will frames are sent from the will as they are when the gateway
+   * asks for them, it must outlive the connection. NULL to connect without
+   * a will.
+   */
+  void
+  setWill(const RMSNWill *will);
+  const RMSNWill *
+  will() const;
+
+  /**
+   * @brief Connect again by itself when the connection is lost
+   *
+   * The connection is lost when a request runs out of retries or the
+   * gateway disconnects us. Attempts are delayed by an exponential backoff
+   * from RMSN_RECONNECT_MIN_DELAY to RMSN_RECONNECT_MAX_DELAY, randomized
+   * so that clients losing the same gateway don't come back together.
+   *
+   * Whoever connects again after a loss, topics of registerTopic() and
+   * subscriptions are renewed in one burst once connected, then
+   * reconnected is emitted. Topic names given to them must outlive the
+   * client.
+   */
+  void
+  setAutoReconnect(const bool enabled);
   bool
+  isAutoReconnect() const;
+  /// Connected, the session may still be renewed.
+  bool
+  isConnected() const;
+  /// The request is invalid if another request or a publish is pending, or
+  /// the topic table is full.
+  RMSNRequest
   registerTopic(const char *name);
 
   /**
@@ -85,8 +228,10 @@ public:
    * @param topicId It should be predefined id if publish with QOS -1.
    * @param data
    * @param dataLen
+   * @return An invalid request if all publish frames are in use, the data
+   * is not sent then.
    */
-  void
+  RMSNRequest
   publish(const uint16_t topicId, const void *data, const uint8_t dataLen);
 #ifdef USE_QOS2
   void
@@ -96,19 +241,51 @@ public:
   void
   pubcomp();
 #endif
-  void
+  /**
+   * @brief Subscribe to a topic by its name
+   *
+   * The subscription is remembered, without copying the name, to bind the
+   * topic id of the SUBACK and to renew it after a lost connection. Like
+   * names given to registerTopic(), topicName must stay valid until it's
+   * unsubscribed or the client is destroyed: a string literal or a static
+   * buffer, not one on the stack.
+   */
+  RMSNRequest
   subscribeByName(const char *topicName);
-  void
+  RMSNRequest
   subscribeById(const uint16_t topicId);
-  void
+  /**
+   * @brief Subscribe to topics with pipelined SUBSCRIBEs
+   *
+   * Up to RMSN_PIPELINE_WINDOW SUBSCRIBEs are in flight at once, each with
+   * its own message id, instead of one round trip per topic. Topic ids
+   * returned in the SUBACKs are set in the topic table, so publishes on
+   * them resolve without a REGISTER.
+   *
+   * The request completes once all topics are answered: ACCEPTED if all
+   * were accepted, otherwise the first rejection. The granted
+   * RMSN_FLAG_QOS_* of each topic, or RMSN_SUBSCRIBE_REJECTED, is written
+   * to grantedQos, which must outlive the batch. Topic names are
+   * remembered like the ones of subscribeByName(), with the same lifetime.
+   * A lost connection cancels the batch, the remembered topics are then
+   * subscribed by the session renewal.
+   *
+   * @return An invalid request if a batch is running, count is not in
+   * [1, RMSN_MAX_BATCH_TOPICS] or some topic would not fit in the
+   * RMSN_MAX_SUBSCRIPTIONS remembered ones.
+   */
+  RMSNRequest
+  subscribeBatch(const char *const *topicNames, const uint8_t count,
+                 uint8_t *grantedQos);
+  RMSNRequest
   unsubscribeByName(const char *topicName);
-  void
+  RMSNRequest
   unsubscribeById(const uint16_t topicId);
-  void
+  RMSNRequest
   pingReq(const char *clientId);
   void
   pingResp();
-  void
+  RMSNRequest
   disconnect(const uint16_t duration=0);
 
   void
@@ -121,10 +298,10 @@ public:
   void
   setKeepAliveInterval(const uint16_t &keepAliveInterval);
 
-  String
+  const char *
   clientId() const;
   void
-  setClientId(const String &clientId);
+  setClientId(const char *clientId);
 
   uint8_t
   responseToWaitFor() const;
@@ -134,34 +311,145 @@ public:
   bool
   isResponsedOrTimeout() const;
 
+  /**
+   * @brief Start building a publish directly in a pool frame
+   *
+   * The publish is committed when the publisher is destroyed. Publishers
+   * could be alive at the same time, up to RMSN_PUBLISH_POOL_SIZE, they
+   * are sent in the order they were started. If no frame is free, the
+   * returned publisher is invalid and the publish is dropped.
+   */
   RMSNPublisher
   publish(const uint16_t topicId);
+  /// Publish with a QoS other than the default one of qos().
+  RMSNPublisher
+  publish(const uint16_t topicId, const uint8_t qos);
 
-protected:
+  /// Encode the publish header of a topic once, see RMSNPublishTemplate.
+  RMSNPublishTemplate
+  publishTemplate(const uint16_t topicId, const uint8_t qos) const;
+  /// The publisher is invalid if the template was made before the session
+  /// was lost, make it again once reconnected is emitted.
+  RMSNPublisher
+  publish(const RMSNPublishTemplate &publishTemplate);
+  RMSNRequest
+  publish(const RMSNPublishTemplate &publishTemplate, const void *data,
+          const uint8_t dataLen);
+
+  /**
+   * @brief Compress payloads of the codec's topics
+   *
+   * Publishes to and publishes received from the codec's topics are encoded
+   * and decoded transparently. Payloads of codec topics are limited to
+   * RMSN_CODEC_MAX_VALUE_SIZE.
+   */
   void
-  publishEnd();
+  setCodec(RMSNCodec *codec);
+  RMSNCodec *
+  codec() const;
 
-  RBufferStream *
-  pubPayloadStream();
+  /**
+   * @brief Keep the last value of the cache's topics
+   *
+   * Publishes delivered to the application are stored in the cache, after
+   * the codec. NULL to disable.
+   */
+  void
+  setValueCache(RMSNValueCache *cache);
+  RMSNValueCache *
+  valueCache() const;
 
+#ifdef RMSN_USE_METRICS
+  const RMSNMetrics *
+  metrics() const;
   void
-  advertiseHandler(const RMSNMsgAdvertise *msg);
+  resetMetrics();
+#endif
+
+protected:
   void
-  gwInfoHandler(const RMSNMsgGwInfo *msg);
+  publishEnd(const uint8_t slot, const uint8_t dataLen);
+  uint8_t *
+  publishFrame(const uint8_t slot);
+  /// False while a publish is built, queued or waiting for its PUBACK in
+  /// mMessageBuffer, or any publish waits for its PUBACK, requests are
+  /// refused then.
+  bool
+  isRequestFrameFree() const;
+  /// @return -1 if all frames are in use.
+  int8_t
+  acquirePublishSlot();
+  /// Send committed publishes, in order, as long as nothing blocks them.
+  void
+  flushPublishes();
+
+  uint8_t
+  maxPublishDataSize(const uint16_t topicId) const;
+  /// Everything but the message id
   void
-  connAckHandler(const RMSNMsgConnAck *msg);
+  encodePublishHeader(RMSNMsgPublish *msg, const uint16_t topicId,
+                      const uint8_t qos) const;
+  /// Apply the codec to a publish payload, return the new length.
+  uint8_t
+  encodePayload(const uint16_t topicId, char *data, const uint8_t dataLen);
+
+  /// @return false if the message should not reach the application.
+  typedef bool (*DispatchHandler)(RMSNClient *client,
+                                  const RMSNMsgHeader *msg);
+
+  /**
+   * @brief The DispatchEntry struct
+   *
+   * How a received message type is handled, indexed by RMSNMsgType.
+   */
+  struct DispatchEntry
+  {
+    /// Frames outside [minLength, maxLength] are dropped as malformed.
+    uint8_t         minLength;
+    uint8_t         maxLength;
+    uint8_t         flags;
+    /// NULL if the type is only passed to received.
+    DispatchHandler handler;
+  };
+
+  template <class View, void (RMSNClient::*handler)(const View &)>
+  static bool
+  dispatchTo(RMSNClient *client, const RMSNMsgHeader *msg);
+  static bool
+  dispatchPublish(RMSNClient *client, const RMSNMsgHeader *msg);
+  static bool
+  dispatchPubAck(RMSNClient *client, const RMSNMsgHeader *msg);
+
   void
-  willTopicReqHandler(const RMSNMsgHeader *msg);
+  advertiseHandler(const RMSNAdvertiseView &msg);
   void
-  willMsgReqHandler(const RMSNMsgHeader *msg);
+  gwInfoHandler(const RMSNGwInfoView &msg);
   void
-  regAckHandler(const RMSNMsgRegAck *msg);
+  connAckHandler(const RMSNReturnCodeView &msg);
   void
-  publishHandler(const RMSNMsgPublish *msg);
+  willTopicReqHandler(const RMSNMsgView &msg);
   void
-  registerHandler(const RMSNMsgRegister *msg);
+  willMsgReqHandler(const RMSNMsgView &msg);
   void
-  pubAckHandler(const RMSNMsgPubAck *msg);
+  regAckHandler(const RMSNTopicAckView &msg);
+  /// @return false if the message should not reach the application.
+  bool
+  publishHandler(RMSNMsgPublish *msg);
+  /**
+   * @brief Remember a received QoS 1 message id
+   *
+   * @return false if it's a retransmission of one already received.
+   */
+  bool
+  acceptInbound(const uint16_t messageId, const bool isDup);
+  void
+  storeValue(const uint16_t topicId, const uint8_t *data,
+             const uint8_t length);
+  void
+  registerHandler(const RMSNRegisterView &msg);
+  /// @return false if it doesn't acknowledge the publish in flight.
+  bool
+  pubAckHandler(const RMSNTopicAckView &msg);
 
 #ifdef USE_QOS2
   void
@@ -173,19 +461,65 @@ protected:
 
 #endif
   void
-  subAckHandler(const RMSNMsgSubAck *msg);
+  subAckHandler(const RMSNSubAckView &msg);
   void
-  unsubAckHandler(const RMSNMsgUnsubAck *msg);
+  unsubAckHandler(const RMSNMessageIdView &msg);
   void
-  pingReqHandler(const RMSNMsgPingReq *msg);
+  pingReqHandler(const RMSNMsgView &msg);
   void
-  pingRespHandler();
+  pingRespHandler(const RMSNMsgView &msg);
   void
-  disconnectHandler(const RMSNMsgDisconnect *msg);
+  disconnectHandler(const RMSNDisconnectView &msg);
+  /// @return false if the message is not an acknowledgement of the renewal.
+  bool
+  rebuildAckHandler(const RMSNMsgHeader *msg);
+  /// @return false if the message is not an acknowledgement of the batch.
+  bool
+  batchAckHandler(const RMSNMsgHeader *msg);
   void
-  willTopicRespHandler(const RMSNMsgWillTopicResp *msg);
+  willTopicRespHandler(const RMSNReturnCodeView &msg);
   void
-  willMsgRespHandler(const RMSNMsgWillMsgResp *msg);
+  willMsgRespHandler(const RMSNReturnCodeView &msg);
+
+  uint8_t
+  beginRequest();
+  /// Remove the request from the pending ones and call its callback.
+  void
+  completeRequest(const uint8_t id, const RMSNRequestResult result);
+  RMSNRequestResult
+  requestResult(const uint8_t id) const;
+  void
+  setRequestCallback(const uint8_t id, RMSNRequestCallback callback,
+                     void *context);
+  /**
+   * @brief Send the request in mMessageBuffer
+   *
+   * @param responseType RMSNMT_INVALID if no response is expected, the
+   * request is accepted once sent.
+   */
+  RMSNRequest
+  sendRequest(const uint8_t responseType);
+  /// Send a request that has no response, it's accepted once sent.
+  RMSNRequest
+  sendUnacked(const RMSNMsgHeader *msg);
+
+  void
+  encodeRegister(RMSNMsgRegister *msg, const char *name,
+                 const uint16_t messageId);
+  /// Subscribe by topicName, or by topicId if it's NULL.
+  void
+  encodeSubscribe(RMSNMsgSubscribe *msg, const char *topicName,
+                  const uint16_t topicId, const uint8_t flags,
+                  const uint16_t messageId);
+  void
+  addSubscription(const char *topicName, const uint16_t topicId,
+                  const uint8_t flags);
+  void
+  removeSubscription(const char *topicName, const uint16_t topicId);
+  /// The name given to subscribeByName(), by a name that is not NUL
+  /// terminated.
+  const char *
+  findSubscriptionName(const char *topicName, const uint8_t nameLen) const;
 
   void
   regAck(const uint16_t topicId, const uint16_t messageId,
@@ -194,17 +528,81 @@ protected:
   pubAck(const uint16_t topicId, const uint16_t messageId,
          const RMSNReturnCode returnCode);
 
+  /// Connected to the idle signal of the event loop.
   void
-  dispatch();
+  onIdle();
+  void
+  drainSubmitQueue();
+  /**
+   * @brief Where to receive a frame of the given length
+   *
+   * @return NULL if the frame could not be received, it will be dropped.
+   */
+  uint8_t *
+  responseBuffer(const uint8_t length);
+  /// @return -1 if no byte came before RMSN_RX_FRAME_TIMEOUT passed since
+  /// startTime.
+  int
+  readByte(const uint32_t startTime);
+  /// Find a topic by a name that is not NUL terminated.
+  RMSNTopic *
+  findTopic(const char *name, const uint8_t nameLen);
+  void
+  dispatch(const RMSNMsgHeader *responseMessage);
+  /// Send the request in mMessageBuffer and wait for its response.
   void
   sendMessage();
+  /// Send a request frame and wait for its response, the frame is kept
+  /// for retransmission.
+  void
+  sendFrame(uint8_t *frame);
+  /// Write a frame that expects no response.
+  void
+  writeMessage(const RMSNMsgHeader *msg);
 
 private:
+  static void
+  onResponseTimerExpired(void *context);
   void
   onResponseTimerTimeout();
+  void
+  setResponseToWaitFor(const uint8_t type);
+
+  static void
+  onReconnectTimerExpired(void *context);
+  void
+  onReconnectTimerTimeout();
+  void
+  connectionLost();
+  void
+  scheduleReconnect();
+  void
+  startRebuild();
+  void
+  finishRebuild();
+  /// Send the REGISTER or SUBSCRIBE of a renewal item.
+  static void
+  sendRebuildFrame(void *context, uint8_t item, uint16_t messageId);
+  static void
+  onRebuildTimeout(void *context);
+  /// Table index of the registered topic of a renewal item, -1 if the item
+  /// is a subscription.
+  int8_t
+  rebuildTopicIndex(uint8_t item) const;
+  uint32_t
+  nextJitter();
+
+  static void
+  sendBatchFrame(void *context, uint8_t item, uint16_t messageId);
+  static void
+  onBatchTimeout(void *context);
+  void
+  finishBatch(const RMSNRequestResult result);
 
 public:
   RSignal<void(const RMSNMsgHeader *msg)> received;
+  /// The session was renewed after a lost connection.
+  RSignal<void()>                         reconnected;
 
 private:
   /// Set to valid message type when we're waiting for some sort of
@@ -213,9 +611,46 @@ private:
   uint16_t      mMessageId;
   uint8_t       mTopicCount;
   uint8_t       mMessageBuffer[RMSN_MAX_BUFFER_SIZE];
+#ifndef RMSN_USE_SINGLE_BUFFER
   uint8_t       mResponseBuffer[RMSN_MAX_BUFFER_SIZE];
-  RBufferStream mPubPayloadStream;
+#endif
   RMSNTopic     mTopicTable[RMSN_MAX_TOPICS];
+#if RMSN_PUBLISH_POOL_SIZE > 1
+  /// Publish frames besides mMessageBuffer
+  uint8_t       mPublishFrames[RMSN_PUBLISH_POOL_SIZE - 1][RMSN_MAX_BUFFER_SIZE];
+#endif
+  uint8_t       mPublishSlotStates[RMSN_PUBLISH_POOL_SIZE];
+  /// Slots in use, in the order they were acquired
+  uint8_t       mPublishOrder[RMSN_PUBLISH_POOL_SIZE];
+  uint8_t       mPublishOrderCount;
+  /// The last request sent, retransmitted until answered.
+  uint8_t      *mRequestFrame;
+
+  /**
+   * @brief The RequestEntry struct
+   */
+  struct RequestEntry
+  {
+    uint8_t             id;
+    uint8_t             result; ///< RMSNRequestResult
+    RMSNRequestCallback callback;
+    void               *context;
+  };
+
+  RequestEntry  mRequests[RMSN_MAX_REQUESTS];
+  uint8_t       mLastRequestId;
+  /// Where the next request is recorded
+  uint8_t       mNextRequest;
+  /// The request mResponseToWaitFor belongs to
+  uint8_t       mPendingRequest;
+  /// Set by the response handlers, the result of the pending request.
+  uint8_t       mResponseResult;
+  /// Requests of the publish frames
+  uint8_t       mPublishRequests[RMSN_PUBLISH_POOL_SIZE];
+  bool          mIsReadinessDriven;
+  /// Set by notifyReadable(), may be from an interrupt.
+  volatile bool mIsReadable;
+  RMSNSubmitQueue *mSubmitQueue;
   uint8_t       mGatewayId;
   /// Default flags
   uint8_t mFlags;
@@ -230,12 +665,76 @@ private:
   uint16_t mKeepAliveInterval;
 
   /// Target stream we will send to.
-  Stream *mStream;
-  String  mClientId;
-  RTimer  mResponseTimer;
-  uint8_t mResponseRetries;
+  Stream        *mStream;
+  char           mClientId[RMSN_MAX_CLIENT_ID_LEN + 1];
+  /// Armed on the shared RMSNTimerWheel while a response is expected
+  RMSNTimerEntry mResponseTimer;
+  uint8_t        mResponseRetries;
+
+  /// Payload compression, NULL if disabled.
+  RMSNCodec      *mCodec;
+  /// Announced on connect, NULL if none.
+  const RMSNWill *mWill;
+  /// Last values of received topics, NULL if disabled.
+  RMSNValueCache *mValueCache;
+
+  /**
+   * @brief The Subscription struct
+   *
+   * By name if name is not NULL, flags hold the QoS and topic type.
+   */
+  struct Subscription
+  {
+    const char *name;
+    uint16_t    topicId;
+    uint8_t     flags;
+  };
+
+  Subscription   mSubscriptions[RMSN_MAX_SUBSCRIPTIONS];
+  uint8_t        mSubscriptionCount;
+  /// Bit i is set if topic i of the table came from registerTopic().
+  uint16_t       mRegisteredTopics;
+  uint8_t        mConnectionState;
+  bool           mIsAutoReconnect;
+  /// The connection was lost, the session must be renewed.
+  bool           mIsSessionLost;
+  /// Changes when topic ids may have changed, templates of another
+  /// generation are refused.
+  uint8_t        mSessionGeneration;
+  uint8_t        mReconnectAttempts;
+  /// Delays the next attempt.
+  RMSNTimerEntry mReconnectTimer;
+  uint32_t       mJitterState;
+  /// REGISTERs of the registered topics, then SUBSCRIBEs of the
+  /// subscriptions, that renew the session.
+  RMSNPipeline   mRebuild;
+  uint8_t        mRebuildTopicCount;
+
+  /// SUBSCRIBEs of the running batch subscribe
+  RMSNPipeline       mBatch;
+  const char *const *mBatchTopics;
+  uint8_t           *mBatchGranted;
+  uint8_t            mBatchRequest;
+  uint8_t            mBatchResult;
+
+  /// Newest QoS 1 message id received in this session
+  uint16_t       mInboundMessageId;
+  /// Bit i is set if mInboundMessageId - i was received.
+  uint32_t       mInboundWindow;
+
+#ifdef RMSN_USE_METRICS
+  RMSNMetrics mMetrics;
+  /// millis() when the request we are waiting for was first sent.
+  uint32_t    mRequestTime;
+  /// millis() when the connection was lost.
+  uint32_t    mLostTime;
+#endif
+
+  /// Stored in PROGMEM
+  static const DispatchEntry sDispatchTable[];
 
   friend RMSNPublisher;
+  friend RMSNRequest;
 };
 
 #endif // __INCLUDED_E457D8FE526A11E7AA6EA088B4D1658C
@@ -0,0 +1,297 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include "RMSNCodec.h"
+
+RMSNCodec::RMSNCodec()
+{
+  for(uint8_t i = 0; i < RMSN_CODEC_MAX_TOPICS; ++i)
+  {
+    mSlots[i].topicId  = RMSN_INVALID_TOPIC_ID;
+    mSlots[i].hasValue = false;
+  }
+}
+
+bool
+RMSNCodec::addTopic(const uint16_t topicId)
+{
+  if(hasTopic(topicId))
+  {
+    return true;
+  }
+
+  Slot *slot = findSlot(RMSN_INVALID_TOPIC_ID);
+
+  if(NULL == slot)
+  {
+    return false;
+  }
+
+  slot->topicId  = topicId;
+  slot->length   = 0;
+  slot->sequence = 0;
+  slot->hasValue = false;
+
+  return true;
+}
+
+void
+RMSNCodec::removeTopic(const uint16_t topicId)
+{
+  Slot *slot = findSlot(topicId);
+
+  if(slot)
+  {
+    slot->topicId = RMSN_INVALID_TOPIC_ID;
+  }
+}
+
+bool
+RMSNCodec::hasTopic(const uint16_t topicId) const
+{
+  return const_cast<RMSNCodec *>(this)->findSlot(topicId) != NULL;
+}
+
+uint8_t
+RMSNCodec::encode(const uint16_t topicId, uint8_t *payload,
+                  const uint8_t length, const uint8_t maxLength)
+{
+  Slot *slot = findSlot(topicId);
+
+  if((NULL == slot)
+     || (length > RMSN_CODEC_MAX_VALUE_SIZE)
+     || (length + 1 > maxLength))
+  {
+    return length;
+  }
+
+  uint8_t delta[RMSN_CODEC_MAX_VALUE_SIZE];
+  uint8_t deltaLength = 0;
+
+  if(slot->hasValue
+     && (slot->length == length)
+     && (slot->sequence % RMSN_CODEC_KEYFRAME_INTERVAL != 0))
+  {
+    deltaLength = encodeDelta(payload, slot->value, length, delta);
+  }
+
+  const uint8_t sequence = slot->sequence;
+
+  memcpy(slot->value, payload, length);
+  slot->length   = length;
+  slot->hasValue = true;
+  slot->sequence = (slot->sequence + 1) & RMSN_CODEC_SEQ_MASK;
+
+  if(deltaLength > 0)
+  {
+    payload[0] = RMSN_CODEC_MODE_DELTA | sequence;
+    memcpy(payload + 1, delta, deltaLength);
+
+    return deltaLength + 1;
+  }
+
+  memmove(payload + 1, payload, length);
+  payload[0] = RMSN_CODEC_MODE_RAW | sequence;
+
+  return length + 1;
+}
+
+int16_t
+RMSNCodec::decode(const uint16_t topicId, uint8_t *payload,
+                  const uint8_t length, const uint8_t maxLength)
+{
+  Slot *slot = findSlot(topicId);
+
+  if(NULL == slot)
+  {
+    return length;
+  }
+
+  if(length < 1)
+  {
+    return -1;
+  }
+
+  const uint8_t mode     = payload[0] & RMSN_CODEC_MODE_MASK;
+  const uint8_t sequence = payload[0] & RMSN_CODEC_SEQ_MASK;
+
+  if(RMSN_CODEC_MODE_RAW == mode)
+  {
+    const uint8_t valueLength = length - 1;
+
+    if(valueLength > RMSN_CODEC_MAX_VALUE_SIZE)
+    {
+      slot->hasValue = false;
+      return -1;
+    }
+
+    memmove(payload, payload + 1, valueLength);
+    memcpy(slot->value, payload, valueLength);
+    slot->length   = valueLength;
+    slot->sequence = sequence;
+    slot->hasValue = true;
+
+    return valueLength;
+  }
+
+  if((RMSN_CODEC_MODE_DELTA != mode)
+     || (!slot->hasValue)
+     || (sequence != ((slot->sequence + 1) & RMSN_CODEC_SEQ_MASK))
+     || (slot->length > maxLength))
+  {
+    // Missed a frame, wait for the next RAW frame.
+    slot->hasValue = false;
+    return -1;
+  }
+
+  uint8_t value[RMSN_CODEC_MAX_VALUE_SIZE];
+
+  if(!decodeDelta(payload + 1, length - 1, slot->value, slot->length, value))
+  {
+    slot->hasValue = false;
+    return -1;
+  }
+
+  memcpy(slot->value, value, slot->length);
+  memcpy(payload, value, slot->length);
+  slot->sequence = sequence;
+
+  return slot->length;
+}
+
+RMSNCodec::Slot *
+RMSNCodec::findSlot(const uint16_t topicId)
+{
+  for(uint8_t i = 0; i < RMSN_CODEC_MAX_TOPICS; ++i)
+  {
+    if(mSlots[i].topicId == topicId)
+    {
+      return &mSlots[i];
+    }
+  }
+
+  return NULL;
+}
+
+uint8_t
+RMSNCodec::encodeDelta(const uint8_t *payload, const uint8_t *previous,
+                       const uint8_t length, uint8_t *output)
+{
+  uint8_t in  = 0;
+  uint8_t out = 0;
+
+  while(in < length)
+  {
+    uint8_t run = 0;
+
+    while((in + run < length)
+          && (run < 128)
+          && (payload[in + run] == previous[in + run]))
+    {
+      ++run;
+    }
+
+    if(run >= 2 || ((run == 1) && (in + 1 == length)))
+    {
+      if(out + 1 >= length)
+      {
+        return 0;
+      }
+
+      output[out++] = 0x80 | (run - 1);
+      in           += run;
+      continue;
+    }
+
+    // Collect literals until the next run of at least two zero bytes.
+    uint8_t literals = 0;
+
+    while((in + literals < length) && (literals < 128))
+    {
+      if((in + literals + 1 < length)
+         && (payload[in + literals] == previous[in + literals])
+         && (payload[in + literals + 1] == previous[in + literals + 1]))
+      {
+        break;
+      }
+
+      ++literals;
+    }
+
+    if(out + 1 + literals >= length)
+    {
+      return 0;
+    }
+
+    output[out++] = literals - 1;
+
+    for(uint8_t i = 0; i < literals; ++i, ++in)
+    {
+      output[out++] = payload[in] ^ previous[in];
+    }
+  }
+
+  return out;
+}
+
+bool
+RMSNCodec::decodeDelta(const uint8_t *input, const uint8_t inputLength,
+                       const uint8_t *previous, const uint8_t length,
+                       uint8_t *output)
+{
+  uint8_t in  = 0;
+  uint8_t out = 0;
+
+  while(in < inputLength)
+  {
+    const uint8_t token = input[in++];
+    const uint8_t count = (token & 0x7F) + 1;
+
+    if(out + count > length)
+    {
+      return false;
+    }
+
+    if(token & 0x80)
+    {
+      memcpy(output + out, previous + out, count);
+      out += count;
+      continue;
+    }
+
+    if(in + count > inputLength)
+    {
+      return false;
+    }
+
+    for(uint8_t i = 0; i < count; ++i, ++in, ++out)
+    {
+      output[out] = input[in] ^ previous[out];
+    }
+  }
+
+  return out == length;
+}
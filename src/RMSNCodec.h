@@ -0,0 +1,122 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_674D70C010FC11E7AA6EA088B4D1658C
+#define __INCLUDED_674D70C010FC11E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+#include "RMSNClient.h"
+
+#define RMSN_CODEC_MAX_TOPICS       4
+/// Largest payload a codec topic could carry, one byte is taken by the
+/// codec header.
+#define RMSN_CODEC_MAX_VALUE_SIZE   (RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish) - 1)
+/// Send the whole value every so many frames, so receivers that missed a
+/// frame recover.
+#define RMSN_CODEC_KEYFRAME_INTERVAL 16
+
+#define RMSN_CODEC_MODE_RAW   0x00
+#define RMSN_CODEC_MODE_DELTA 0x40
+#define RMSN_CODEC_MODE_MASK  0xC0
+#define RMSN_CODEC_SEQ_MASK   0x3F
+
+/**
+ * @brief The RMSNCodec class
+ *
+ * Per-topic payload compression for repetitive records. Every payload of a
+ * codec topic starts with a header byte: the mode in the upper 2 bits and
+ * a sequence number in the lower 6 bits.
+ *
+ * RAW frames carry the value as is. DELTA frames carry the value XORed with
+ * the previous one, run-length encoded: a token byte with the high bit set
+ * stands for (token & 0x7F) + 1 zero bytes, otherwise (token + 1) literal
+ * bytes follow. A DELTA frame is only accepted right after the previous
+ * sequence number, otherwise it's dropped until the next RAW frame.
+ *
+ * One codec keeps one value per topic, so a topic should only be published
+ * or only be received through the same codec.
+ */
+class RMSNCodec
+{
+public:
+  RMSNCodec();
+
+  bool
+  addTopic(const uint16_t topicId);
+  void
+  removeTopic(const uint16_t topicId);
+  bool
+  hasTopic(const uint16_t topicId) const;
+
+  /**
+   * @brief Encode a payload in place
+   *
+   * @param maxLength Room of the payload buffer, at least length + 1.
+   * @return Encoded length, or length unchanged if the topic is not a codec
+   * topic.
+   */
+  uint8_t
+  encode(const uint16_t topicId, uint8_t *payload, const uint8_t length,
+         const uint8_t maxLength);
+
+  /**
+   * @brief Decode a payload in place
+   *
+   * @return Decoded length, length unchanged if the topic is not a codec
+   * topic, -1 if the payload could not be decoded.
+   */
+  int16_t
+  decode(const uint16_t topicId, uint8_t *payload, const uint8_t length,
+         const uint8_t maxLength);
+
+private:
+  struct Slot
+  {
+    uint16_t topicId;
+    uint8_t  length;
+    uint8_t  sequence;
+    bool     hasValue;
+    uint8_t  value[RMSN_CODEC_MAX_VALUE_SIZE];
+  };
+
+  Slot *
+  findSlot(const uint16_t topicId);
+
+  /// Run-length encode (payload XOR previous), return 0 if it's not smaller.
+  static uint8_t
+  encodeDelta(const uint8_t *payload, const uint8_t *previous,
+              const uint8_t length, uint8_t *output);
+
+  /// Inverse of encodeDelta(), return false on malformed input.
+  static bool
+  decodeDelta(const uint8_t *input, const uint8_t inputLength,
+              const uint8_t *previous, const uint8_t length,
+              uint8_t *output);
+
+private:
+  Slot mSlots[RMSN_CODEC_MAX_TOPICS];
+};
+
+#endif // __INCLUDED_674D70C010FC11E7AA6EA088B4D1658C
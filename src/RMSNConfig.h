@@ -0,0 +1,64 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_05BDAC52545C11E7AA6EA088B4D1658C
+#define __INCLUDED_05BDAC52545C11E7AA6EA088B4D1658C
+
+// Build options of the library. Options must be set here rather than in a
+// sketch, they change the layout of RMSNClient and every translation unit
+// must agree on them.
+
+/// Count frames, bytes, retries and response times, see RMSNMetrics.
+// #define RMSN_USE_METRICS
+
+/// With RMSN_USE_METRICS, also count bytes per message type. It costs
+/// another RMSN_METRICS_MSG_TYPES * 8 bytes of RAM per client.
+// #define RMSN_USE_METRICS_BYTES
+
+/// Record protocol events into a RAM ring buffer, see RMSNTrace.
+// #define RMSN_USE_TRACE
+
+/// Share one frame buffer for sending and receiving, it saves
+/// RMSN_MAX_BUFFER_SIZE bytes of RAM. While waiting for a response, frames
+/// are received behind the request kept for retransmission; frames that
+/// don't fit are dropped. The message passed to RMSNClient::received is
+/// only valid until the next request.
+// #define RMSN_USE_SINGLE_BUFFER
+
+/// Publishes that could be built and queued at once. Each one but the first
+/// costs RMSN_MAX_BUFFER_SIZE bytes of RAM; the first is built in the
+/// request buffer, and while it's there connect(), subscribe and the other
+/// requests are refused. Defaults to 2, or 1 with RMSN_USE_SINGLE_BUFFER:
+/// publishes and requests then take turns, and a publish is refused while
+/// a response is pending.
+// #define RMSN_PUBLISH_POOL_SIZE 2
+
+/// Subscriptions remembered to be renewed after a reconnection, also the
+/// most topics one RMSNClient::subscribeBatch() carries. Each one costs 5
+/// bytes of RAM on AVR, above 22 the pipelines take 4 bytes more each.
+/// Defaults to 8, at most 54.
+// #define RMSN_MAX_SUBSCRIPTIONS 8
+
+#endif // __INCLUDED_05BDAC52545C11E7AA6EA088B4D1658C
@@ -0,0 +1,787 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include <RByteOrder.h>
+#include "RMSNLocalGateway.h"
+#include "RMSNUtils.h"
+
+RMSNLocalGateway::RMSNLocalGateway(const uint8_t gwId) :
+  mGatewayId(gwId),
+  mIsConnected(false),
+  mLatency(0),
+  mLossRate(0),
+  mCongestionRate(0),
+  mRequestLength(0),
+  mQueueHead(0),
+  mQueueCount(0),
+  mReadRemaining(0),
+  mTopicCount(0),
+  mMessageId(0),
+  mLastRequestType(RMSNMT_INVALID),
+  mLastRequestId(0)
+{
+  memset(mRequest, 0, RMSN_MAX_BUFFER_SIZE);
+  memset(mTopics, 0, sizeof(Topic) * RMSN_GW_MAX_TOPICS);
+  resetCounters();
+}
+
+RMSNLocalGateway::~RMSNLocalGateway()
+{
+}
+
+int
+RMSNLocalGateway::available()
+{
+  if(isFrontReady())
+  {
+    return mReadRemaining;
+  }
+
+  return 0;
+}
+
+int
+RMSNLocalGateway::read()
+{
+  if(!isFrontReady())
+  {
+    return -1;
+  }
+
+  uint8_t c;
+
+  popFront(&c, 1);
+  --mReadRemaining;
+
+  return c;
+}
+
+int
+RMSNLocalGateway::peek()
+{
+  if(!isFrontReady())
+  {
+    return -1;
+  }
+
+  return mQueue[mQueueHead];
+}
+
+size_t
+RMSNLocalGateway::write(uint8_t c)
+{
+  if((0 == mRequestLength)
+     && ((c < sizeof(RMSNMsgHeader)) || (c > RMSN_MAX_BUFFER_SIZE)))
+  {
+    // Not a length we could handle (including the 3 bytes length form),
+    // drop bytes until we are synchronized again.
+    return 1;
+  }
+
+  mRequest[mRequestLength++] = c;
+
+  if(mRequestLength >= mRequest[0])
+  {
+    mRequestLength = 0;
+    ++mFramesReceived;
+
+    if(isLost())
+    {
+      ++mFramesLost;
+    }
+    else
+    {
+      process(reinterpret_cast<RMSNMsgHeader *>(mRequest));
+    }
+  }
+
+  return 1;
+}
+
+size_t
+RMSNLocalGateway::write(const uint8_t *buffer, size_t size)
+{
+  for(size_t i = 0; i < size; ++i)
+  {
+    write(buffer[i]);
+  }
+
+  return size;
+}
+
+void
+RMSNLocalGateway::flush()
+{
+}
+
+void
+RMSNLocalGateway::advertise(const uint16_t duration)
+{
+  RMSNMsgAdvertise msg;
+
+  msg.length   = sizeof(RMSNMsgAdvertise);
+  msg.type     = RMSNMT_ADVERTISE;
+  msg.gwId     = mGatewayId;
+  msg.duration = rHtons(duration);
+
+  enqueue(&msg);
+}
+
+void
+RMSNLocalGateway::publish(const uint16_t topicId, const void *data,
+                          const uint8_t dataLen)
+{
+  int8_t index = topicIndex(topicId);
+
+  if((index < 0)
+     || (RMSN_FLAG_QOS_M1 == mTopics[index].subscribedQos)
+     || (dataLen > RMSN_GET_MAX_DATA_SIZE(RMSNMsgPublish)))
+  {
+    return;
+  }
+
+  uint8_t         buffer[RMSN_MAX_BUFFER_SIZE];
+  RMSNMsgPublish *msg = reinterpret_cast<RMSNMsgPublish *>(buffer);
+
+  ++mMessageId;
+
+  msg->length    = sizeof(RMSNMsgPublish) + dataLen;
+  msg->type      = RMSNMT_PUBLISH;
+  msg->flags     = mTopics[index].subscribedQos
+                   | mTopics[index].subscribedTopicType;
+  msg->topicId   = rHtons(topicId);
+  msg->messageId = rHtons(mMessageId);
+  memcpy(msg->data, data, dataLen);
+
+  enqueue(msg);
+}
+
+void
+RMSNLocalGateway::restart()
+{
+  mIsConnected     = false;
+  mTopicCount      = 0;
+  mLastRequestType = RMSNMT_INVALID;
+  mLastRequestId   = 0;
+
+  respond(RMSNMT_DISCONNECT);
+}
+
+void
+RMSNLocalGateway::setLatency(const uint16_t latency)
+{
+  mLatency = latency;
+}
+
+void
+RMSNLocalGateway::setLossRate(const uint8_t percent)
+{
+  mLossRate = percent;
+}
+
+void
+RMSNLocalGateway::setCongestionRate(const uint8_t percent)
+{
+  mCongestionRate = percent;
+}
+
+bool
+RMSNLocalGateway::isConnected() const
+{
+  return mIsConnected;
+}
+
+uint16_t
+RMSNLocalGateway::framesReceived() const
+{
+  return mFramesReceived;
+}
+
+uint16_t
+RMSNLocalGateway::framesSent() const
+{
+  return mFramesSent;
+}
+
+uint16_t
+RMSNLocalGateway::framesLost() const
+{
+  return mFramesLost;
+}
+
+uint16_t
+RMSNLocalGateway::congestionRejects() const
+{
+  return mCongestionRejects;
+}
+
+uint16_t
+RMSNLocalGateway::retransmits() const
+{
+  return mRetransmits;
+}
+
+void
+RMSNLocalGateway::resetCounters()
+{
+  mFramesReceived    = 0;
+  mFramesSent        = 0;
+  mFramesLost        = 0;
+  mCongestionRejects = 0;
+  mRetransmits       = 0;
+}
+
+void
+RMSNLocalGateway::process(const RMSNMsgHeader *msg)
+{
+  bool     isRequest = true;
+  uint16_t messageId = 0;
+
+  switch(msg->type)
+  {
+  case RMSNMT_CONNECT:
+    break;
+
+  case RMSNMT_REGISTER:
+    messageId = reinterpret_cast<const RMSNMsgRegister *>(msg)->messageId;
+    break;
+
+  case RMSNMT_PUBLISH:
+    messageId = reinterpret_cast<const RMSNMsgPublish *>(msg)->messageId;
+    break;
+
+  case RMSNMT_SUBSCRIBE:
+  case RMSNMT_UNSUBSCRIBE:
+    messageId = reinterpret_cast<const RMSNMsgSubscribe *>(msg)->messageId;
+    break;
+
+  default:
+    isRequest = false;
+    break;
+  }
+
+  if(isRequest)
+  {
+    if((mLastRequestType == msg->type) && (mLastRequestId == messageId))
+    {
+      ++mRetransmits;
+    }
+
+    mLastRequestType = msg->type;
+    mLastRequestId   = messageId;
+  }
+
+  switch(msg->type)
+  {
+  case RMSNMT_SEARCHGW:
+    searchGwHandler(reinterpret_cast<const RMSNMsgSearchGw *>(msg));
+    break;
+
+  case RMSNMT_CONNECT:
+    connectHandler(reinterpret_cast<const RMSNMsgConnect *>(msg));
+    break;
+
+  case RMSNMT_WILLTOPIC:
+    willTopicHandler(msg);
+    break;
+
+  case RMSNMT_WILLMSG:
+    willMsgHandler(reinterpret_cast<const RMSNMsgWillMsg *>(msg));
+    break;
+
+  case RMSNMT_REGISTER:
+    registerHandler(reinterpret_cast<const RMSNMsgRegister *>(msg));
+    break;
+
+  case RMSNMT_PUBLISH:
+    publishHandler(reinterpret_cast<const RMSNMsgPublish *>(msg));
+    break;
+
+  case RMSNMT_PUBREL:
+    pubRelHandler(reinterpret_cast<const RMSNMsgPubQos2 *>(msg));
+    break;
+
+  case RMSNMT_SUBSCRIBE:
+    subscribeHandler(reinterpret_cast<const RMSNMsgSubscribe *>(msg));
+    break;
+
+  case RMSNMT_UNSUBSCRIBE:
+    unsubscribeHandler(reinterpret_cast<const RMSNMsgUnsubscribe *>(msg));
+    break;
+
+  case RMSNMT_PINGREQ:
+    respond(RMSNMT_PINGRESP);
+    break;
+
+  case RMSNMT_DISCONNECT:
+    mIsConnected = false;
+    respond(RMSNMT_DISCONNECT);
+    break;
+
+  default:
+    // Acknowledgements of our deliveries, nothing to do.
+    break;
+  }
+}
+
+void
+RMSNLocalGateway::searchGwHandler(const RMSNMsgSearchGw *)
+{
+  RMSNMsgGwInfo response;
+
+  response.length = sizeof(RMSNMsgGwInfo);
+  response.type   = RMSNMT_GWINFO;
+  response.gwId   = mGatewayId;
+
+  enqueue(&response);
+}
+
+void
+RMSNLocalGateway::connectHandler(const RMSNMsgConnect *msg)
+{
+  if(msg->length < sizeof(RMSNMsgConnect))
+  {
+    return;
+  }
+
+  mIsConnected = false;
+
+  if(isCongested())
+  {
+    respondReturnCode(RMSNMT_CONNACK, 0, 0, RMSNRC_REJECTED_CONGESTION);
+  }
+  else if(msg->flags & RMSN_FLAG_WILL)
+  {
+    respond(RMSNMT_WILLTOPICREQ);
+  }
+  else
+  {
+    mIsConnected = true;
+    respondReturnCode(RMSNMT_CONNACK, 0, 0, RMSNRC_ACCEPTED);
+  }
+}
+
+void
+RMSNLocalGateway::willTopicHandler(const RMSNMsgHeader *)
+{
+  respond(RMSNMT_WILLMSGREQ);
+}
+
+void
+RMSNLocalGateway::willMsgHandler(const RMSNMsgWillMsg *)
+{
+  mIsConnected = true;
+  respondReturnCode(RMSNMT_CONNACK, 0, 0, RMSNRC_ACCEPTED);
+}
+
+void
+RMSNLocalGateway::registerHandler(const RMSNMsgRegister *msg)
+{
+  if(msg->length < sizeof(RMSNMsgRegister))
+  {
+    return;
+  }
+
+  if(isCongested())
+  {
+    respondReturnCode(RMSNMT_REGACK, 0, rNtohs(msg->messageId),
+                      RMSNRC_REJECTED_CONGESTION);
+    return;
+  }
+
+  int8_t index = topicIndex(msg->topicName,
+                            msg->length - sizeof(RMSNMsgRegister));
+
+  if(index < 0)
+  {
+    respondReturnCode(RMSNMT_REGACK, 0, rNtohs(msg->messageId),
+                      RMSNRC_REJECTED_NOT_SUPPORTED);
+    return;
+  }
+
+  respondReturnCode(RMSNMT_REGACK, mTopics[index].id, rNtohs(msg->messageId),
+                    RMSNRC_ACCEPTED);
+}
+
+void
+RMSNLocalGateway::publishHandler(const RMSNMsgPublish *msg)
+{
+  if(msg->length < sizeof(RMSNMsgPublish))
+  {
+    return;
+  }
+
+  const uint8_t  qos       = msg->flags & RMSN_QOS_MASK;
+  const uint16_t topicId   = rNtohs(msg->topicId);
+  const uint16_t messageId = rNtohs(msg->messageId);
+  RMSNReturnCode ret       = RMSNRC_ACCEPTED;
+
+  if(((msg->flags & RMSN_TOPIC_MASK) == RMSN_FLAG_TOPIC_NAME)
+     && (topicIndex(topicId) < 0))
+  {
+    ret = RMSNRC_REJECTED_INVALID_TOPIC_ID;
+  }
+  else if(fmsnIsHighQos(qos) && isCongested())
+  {
+    ret = RMSNRC_REJECTED_CONGESTION;
+  }
+
+  if((RMSN_FLAG_QOS_1 == qos) || (ret != RMSNRC_ACCEPTED))
+  {
+    if(fmsnIsHighQos(qos))
+    {
+      respondReturnCode(RMSNMT_PUBACK, topicId, messageId, ret);
+    }
+  }
+  else if(RMSN_FLAG_QOS_2 == qos)
+  {
+    respondMessageId(RMSNMT_PUBREC, messageId);
+  }
+
+  if(RMSNRC_ACCEPTED == ret)
+  {
+    publish(topicId, msg->data, msg->length - sizeof(RMSNMsgPublish));
+  }
+}
+
+void
+RMSNLocalGateway::pubRelHandler(const RMSNMsgPubQos2 *msg)
+{
+  respondMessageId(RMSNMT_PUBCOMP, rNtohs(msg->messageId));
+}
+
+void
+RMSNLocalGateway::subscribeHandler(const RMSNMsgSubscribe *msg)
+{
+  // The -2 here is because we're unioning a 0-length member (topicName)
+  // with a uint16_t in the msg_subscribe struct.
+  const uint8_t headerSize = sizeof(RMSNMsgSubscribe) - 2;
+
+  if(msg->length < headerSize)
+  {
+    return;
+  }
+
+  const uint16_t messageId = rNtohs(msg->messageId);
+  uint8_t        qos       = msg->flags & RMSN_QOS_MASK;
+  int8_t         index     = -1;
+
+  if(isCongested())
+  {
+    respondReturnCode(RMSNMT_SUBACK, 0, messageId,
+                      RMSNRC_REJECTED_CONGESTION);
+    return;
+  }
+
+  if((msg->flags & RMSN_TOPIC_MASK) == RMSN_FLAG_TOPIC_NAME)
+  {
+    index = topicIndex(msg->topicName, msg->length - headerSize);
+  }
+  else if(msg->length >= sizeof(RMSNMsgSubscribe))
+  {
+    // Predefined and short topic names both occupy the topic id field.
+    const uint16_t topicId = rNtohs(msg->topicId);
+
+    index = topicIndex(topicId);
+
+    if((index < 0) && (mTopicCount < RMSN_GW_MAX_TOPICS))
+    {
+      index = mTopicCount++;
+      mTopics[index].name[0] = 0;
+      mTopics[index].id      = topicId;
+    }
+  }
+
+  if(index < 0)
+  {
+    respondReturnCode(RMSNMT_SUBACK, 0, messageId,
+                      RMSNRC_REJECTED_NOT_SUPPORTED);
+    return;
+  }
+
+  if(RMSN_FLAG_QOS_M1 == qos)
+  {
+    qos = RMSN_FLAG_QOS_0;
+  }
+
+  mTopics[index].subscribedQos       = qos;
+  mTopics[index].subscribedTopicType = msg->flags & RMSN_TOPIC_MASK;
+
+  uint8_t        buffer[sizeof(RMSNMsgSubAck)];
+  RMSNMsgSubAck *response = reinterpret_cast<RMSNMsgSubAck *>(buffer);
+
+  response->length     = sizeof(RMSNMsgSubAck);
+  response->type       = RMSNMT_SUBACK;
+  response->flags      = qos;
+  response->topicId    = rHtons(mTopics[index].id);
+  response->messageId  = rHtons(messageId);
+  response->returnCode = RMSNRC_ACCEPTED;
+
+  enqueue(response);
+}
+
+void
+RMSNLocalGateway::unsubscribeHandler(const RMSNMsgUnsubscribe *msg)
+{
+  const uint8_t headerSize = sizeof(RMSNMsgUnsubscribe) - 2;
+
+  if(msg->length < headerSize)
+  {
+    return;
+  }
+
+  int8_t index = -1;
+
+  if((msg->flags & RMSN_TOPIC_MASK) == RMSN_FLAG_TOPIC_NAME)
+  {
+    index = topicIndex(msg->topicName, msg->length - headerSize);
+  }
+  else if(msg->length >= sizeof(RMSNMsgUnsubscribe))
+  {
+    index = topicIndex(rNtohs(msg->topicId));
+  }
+
+  if(index >= 0)
+  {
+    mTopics[index].subscribedQos = RMSN_FLAG_QOS_M1;
+  }
+
+  respondMessageId(RMSNMT_UNSUBACK, rNtohs(msg->messageId));
+}
+
+void
+RMSNLocalGateway::respond(const RMSNMsgType type)
+{
+  RMSNMsgHeader msg;
+
+  msg.length = sizeof(RMSNMsgHeader);
+  msg.type   = type;
+
+  enqueue(&msg);
+}
+
+void
+RMSNLocalGateway::respondMessageId(const RMSNMsgType type,
+                                   const uint16_t messageId)
+{
+  RMSNMsgPubQos2 msg;
+
+  msg.length    = sizeof(RMSNMsgPubQos2);
+  msg.type      = type;
+  msg.messageId = rHtons(messageId);
+
+  enqueue(&msg);
+}
+
+void
+RMSNLocalGateway::respondReturnCode(const RMSNMsgType type,
+                                    const uint16_t topicId,
+                                    const uint16_t messageId,
+                                    const RMSNReturnCode returnCode)
+{
+  if(returnCode == RMSNRC_REJECTED_CONGESTION)
+  {
+    ++mCongestionRejects;
+  }
+
+  if(RMSNMT_CONNACK == type)
+  {
+    RMSNMsgConnAck msg;
+
+    msg.length     = sizeof(RMSNMsgConnAck);
+    msg.type       = type;
+    msg.returnCode = returnCode;
+
+    enqueue(&msg);
+  }
+  else if(RMSNMT_SUBACK == type)
+  {
+    RMSNMsgSubAck msg;
+
+    msg.length     = sizeof(RMSNMsgSubAck);
+    msg.type       = type;
+    msg.flags      = 0;
+    msg.topicId    = rHtons(topicId);
+    msg.messageId  = rHtons(messageId);
+    msg.returnCode = returnCode;
+
+    enqueue(&msg);
+  }
+  else
+  {
+    // REGACK and PUBACK share the same layout.
+    RMSNMsgPubAck msg;
+
+    msg.length     = sizeof(RMSNMsgPubAck);
+    msg.type       = type;
+    msg.topicId    = rHtons(topicId);
+    msg.messageId  = rHtons(messageId);
+    msg.returnCode = returnCode;
+
+    enqueue(&msg);
+  }
+}
+
+void
+RMSNLocalGateway::enqueue(const RMSNMsgHeader *msg)
+{
+  if(isLost()
+     || (mQueueCount + sizeof(uint32_t) + msg->length > RMSN_GW_QUEUE_SIZE))
+  {
+    ++mFramesLost;
+    return;
+  }
+
+  const uint32_t due   = millis() + mLatency;
+  const uint8_t *frame = reinterpret_cast<const uint8_t *>(msg);
+
+  for(uint8_t i = 0; i < sizeof(uint32_t); ++i)
+  {
+    mQueue[(mQueueHead + mQueueCount++) % RMSN_GW_QUEUE_SIZE] =
+      static_cast<uint8_t>(due >> (i * 8));
+  }
+
+  for(uint8_t i = 0; i < msg->length; ++i)
+  {
+    mQueue[(mQueueHead + mQueueCount++) % RMSN_GW_QUEUE_SIZE] = frame[i];
+  }
+
+  ++mFramesSent;
+}
+
+int8_t
+RMSNLocalGateway::topicIndex(const char *name, const uint8_t nameLen)
+{
+  if((0 == nameLen) || (nameLen > RMSN_GW_MAX_TOPIC_NAME_LEN))
+  {
+    return -1;
+  }
+
+  for(uint8_t i = 0; i < mTopicCount; ++i)
+  {
+    if((strncmp(mTopics[i].name, name, nameLen) == 0)
+       && (0 == mTopics[i].name[nameLen]))
+    {
+      return i;
+    }
+  }
+
+  if(mTopicCount >= RMSN_GW_MAX_TOPICS)
+  {
+    return -1;
+  }
+
+  // Allocate the next unused normal topic id.
+  uint16_t topicId = mTopicCount + 1;
+
+  while(topicIndex(topicId) >= 0)
+  {
+    ++topicId;
+  }
+
+  Topic *topic = &mTopics[mTopicCount];
+
+  memcpy(topic->name, name, nameLen);
+  topic->name[nameLen]       = 0;
+  topic->id                  = topicId;
+  topic->subscribedQos       = RMSN_FLAG_QOS_M1;
+  topic->subscribedTopicType = RMSN_FLAG_TOPIC_NAME;
+
+  return mTopicCount++;
+}
+
+int8_t
+RMSNLocalGateway::topicIndex(const uint16_t topicId) const
+{
+  for(uint8_t i = 0; i < mTopicCount; ++i)
+  {
+    if(mTopics[i].id == topicId)
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+bool
+RMSNLocalGateway::isLost()
+{
+  return (mLossRate > 0) && (random(100) < mLossRate);
+}
+
+bool
+RMSNLocalGateway::isCongested()
+{
+  return (mCongestionRate > 0) && (random(100) < mCongestionRate);
+}
+
+bool
+RMSNLocalGateway::isFrontReady()
+{
+  if(mReadRemaining > 0)
+  {
+    return true;
+  }
+
+  if(0 == mQueueCount)
+  {
+    return false;
+  }
+
+  uint32_t due = 0;
+
+  for(uint8_t i = 0; i < sizeof(uint32_t); ++i)
+  {
+    due |= static_cast<uint32_t>(
+      mQueue[(mQueueHead + i) % RMSN_GW_QUEUE_SIZE]) << (i * 8);
+  }
+
+  if(static_cast<int32_t>(millis() - due) < 0)
+  {
+    return false;
+  }
+
+  popFront(NULL, sizeof(uint32_t));
+  mReadRemaining = mQueue[mQueueHead];
+
+  return true;
+}
+
+void
+RMSNLocalGateway::popFront(uint8_t *dest, uint16_t size)
+{
+  for(uint16_t i = 0; i < size; ++i)
+  {
+    if(dest)
+    {
+      dest[i] = mQueue[mQueueHead];
+    }
+
+    mQueueHead = (mQueueHead + 1) % RMSN_GW_QUEUE_SIZE;
+    --mQueueCount;
+  }
+}
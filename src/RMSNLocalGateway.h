@@ -0,0 +1,218 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_5B605F877ABC11E7AA6EA088B4D1658C
+#define __INCLUDED_5B605F877ABC11E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+#include "RMSNClient.h"
+
+#ifndef RMSN_GW_MAX_TOPICS
+#define RMSN_GW_MAX_TOPICS         16
+#endif
+#define RMSN_GW_MAX_TOPIC_NAME_LEN 23
+#define RMSN_GW_QUEUE_SIZE         (RMSN_MAX_BUFFER_SIZE * 4)
+
+/**
+ * @brief The RMSNLocalGateway class
+ *
+ * A minimal in-process MQTT-SN gateway. It is a Stream, so a client could be
+ * started on it directly with RMSNClient::begin() instead of a serial port.
+ * Frames written by the client are answered immediately, responses are
+ * queued and become readable after the configured latency.
+ *
+ * It's intended for tests, benchmarks and soak runs, not for production: only
+ * one client is served, subscriptions are routed back to that client and
+ * QoS 1/2 deliveries to the client are never retransmitted.
+ */
+class RMSNLocalGateway : public Stream
+{
+public:
+  RMSNLocalGateway(const uint8_t gwId=1);
+  ~RMSNLocalGateway();
+
+  int
+  available();
+  int
+  read();
+  int
+  peek();
+  size_t
+  write(uint8_t c);
+  size_t
+  write(const uint8_t *buffer, size_t size);
+  void
+  flush();
+
+  /**
+   * @brief Queue an ADVERTISE frame to the client.
+   *
+   * @param duration Seconds until next advertise.
+   */
+  void
+  advertise(const uint16_t duration=RMSN_T_ADV);
+
+  /**
+   * @brief Publish to the client as if another client did.
+   *
+   * The message only reaches the client if it subscribed to the topic.
+   */
+  void
+  publish(const uint16_t topicId, const void *data, const uint8_t dataLen);
+
+  /**
+   * @brief Lose the session as a restarting gateway would
+   *
+   * Topics and subscriptions are forgotten and the client gets a
+   * DISCONNECT, it must connect and register again.
+   */
+  void
+  restart();
+
+  /// Delay in milliseconds before a response becomes readable.
+  void
+  setLatency(const uint16_t latency);
+  /// Probability in percent that a frame is lost, in either direction.
+  void
+  setLossRate(const uint8_t percent);
+  /// Probability in percent that a request is rejected with congestion.
+  void
+  setCongestionRate(const uint8_t percent);
+
+  bool
+  isConnected() const;
+
+  uint16_t
+  framesReceived() const;
+  uint16_t
+  framesSent() const;
+  uint16_t
+  framesLost() const;
+  uint16_t
+  congestionRejects() const;
+
+  /// Requests received again with the same type and message id.
+  uint16_t
+  retransmits() const;
+
+  void
+  resetCounters();
+
+protected:
+  void
+  process(const RMSNMsgHeader *msg);
+
+  void
+  searchGwHandler(const RMSNMsgSearchGw *msg);
+  void
+  connectHandler(const RMSNMsgConnect *msg);
+  void
+  willTopicHandler(const RMSNMsgHeader *msg);
+  void
+  willMsgHandler(const RMSNMsgWillMsg *msg);
+  void
+  registerHandler(const RMSNMsgRegister *msg);
+  void
+  publishHandler(const RMSNMsgPublish *msg);
+  void
+  pubRelHandler(const RMSNMsgPubQos2 *msg);
+  void
+  subscribeHandler(const RMSNMsgSubscribe *msg);
+  void
+  unsubscribeHandler(const RMSNMsgUnsubscribe *msg);
+
+  void
+  respond(const RMSNMsgType type);
+  void
+  respondMessageId(const RMSNMsgType type, const uint16_t messageId);
+  void
+  respondReturnCode(const RMSNMsgType type, const uint16_t topicId,
+                    const uint16_t messageId,
+                    const RMSNReturnCode returnCode);
+  void
+  enqueue(const RMSNMsgHeader *msg);
+
+  /// Find topic index by name, create it if it does not exist.
+  int8_t
+  topicIndex(const char *name, const uint8_t nameLen);
+  /// Find topic index by id, -1 if it does not exist.
+  int8_t
+  topicIndex(const uint16_t topicId) const;
+
+  bool
+  isLost();
+  bool
+  isCongested();
+
+private:
+  bool
+  isFrontReady();
+  void
+  popFront(uint8_t *dest, uint16_t size);
+
+private:
+  struct Topic
+  {
+    char     name[RMSN_GW_MAX_TOPIC_NAME_LEN + 1];
+    uint16_t id;
+    /// RMSN_FLAG_QOS_* granted to subscriber, RMSN_FLAG_QOS_M1 means none.
+    uint8_t  subscribedQos;
+    /// RMSN_FLAG_TOPIC_* the client subscribed with, routed publishes
+    /// carry the same topic type.
+    uint8_t  subscribedTopicType;
+  };
+
+  uint8_t  mGatewayId;
+  bool     mIsConnected;
+  uint16_t mLatency;
+  uint8_t  mLossRate;
+  uint8_t  mCongestionRate;
+
+  /// Frame being written by the client.
+  uint8_t mRequest[RMSN_MAX_BUFFER_SIZE];
+  uint8_t mRequestLength;
+
+  /// Queued responses, each one is prefixed by its due time in millis().
+  uint8_t  mQueue[RMSN_GW_QUEUE_SIZE];
+  uint16_t mQueueHead;
+  uint16_t mQueueCount;
+  /// Bytes left of the response being read by the client.
+  uint8_t  mReadRemaining;
+
+  Topic    mTopics[RMSN_GW_MAX_TOPICS];
+  uint8_t  mTopicCount;
+  uint16_t mMessageId;
+
+  uint8_t  mLastRequestType;
+  uint16_t mLastRequestId;
+
+  uint16_t mFramesReceived;
+  uint16_t mFramesSent;
+  uint16_t mFramesLost;
+  uint16_t mCongestionRejects;
+  uint16_t mRetransmits;
+};
+
+#endif // __INCLUDED_5B605F877ABC11E7AA6EA088B4D1658C
@@ -0,0 +1,108 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include "RMSNMetrics.h"
+
+/// Frame counter index of each message type up to RMSNMT_WILLMSGRESP
+static const uint8_t sMsgTypeIndexes[] PROGMEM = {
+  // RMSNMT_ADVERTISE, RMSNMT_SEARCHGW, RMSNMT_GWINFO, 0x03
+  0, 1, 2, RMSN_METRICS_NO_INDEX,
+  // RMSNMT_CONNECT ... RMSNMT_PUBREL
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+  // 0x11
+  RMSN_METRICS_NO_INDEX,
+  // RMSNMT_SUBSCRIBE ... RMSNMT_DISCONNECT, 0x19
+  16, 17, 18, 19, 20, 21, 22, RMSN_METRICS_NO_INDEX,
+  // RMSNMT_WILLTOPICUPD ... RMSNMT_WILLMSGRESP
+  23, 24, 25, 26,
+};
+
+void
+RMSNMetrics::reset()
+{
+  memset(this, 0, sizeof(RMSNMetrics));
+}
+
+void
+RMSNMetrics::countTx(const RMSNMsgHeader *msg)
+{
+  const uint8_t index = msgTypeIndex(msg->type);
+
+  if(RMSN_METRICS_NO_INDEX != index)
+  {
+    ++txFrames[index];
+    txBytes += msg->length;
+#ifdef RMSN_USE_METRICS_BYTES
+    txTypeBytes[index] += msg->length;
+#endif
+  }
+}
+
+void
+RMSNMetrics::countRx(const RMSNMsgHeader *msg)
+{
+  const uint8_t index = msgTypeIndex(msg->type);
+
+  if(RMSN_METRICS_NO_INDEX != index)
+  {
+    ++rxFrames[index];
+    rxBytes += msg->length;
+#ifdef RMSN_USE_METRICS_BYTES
+    rxTypeBytes[index] += msg->length;
+#endif
+  }
+}
+
+void
+RMSNMetrics::recordRtt(uint32_t rtt)
+{
+  ++rttHistogram[rttBucket(rtt)];
+}
+
+uint8_t
+RMSNMetrics::rttBucket(uint32_t rtt)
+{
+  uint8_t bucket = 0;
+
+  while((rtt > 1) && (bucket < RMSN_METRICS_RTT_BUCKETS - 1))
+  {
+    rtt >>= 1;
+    ++bucket;
+  }
+
+  return bucket;
+}
+
+uint8_t
+RMSNMetrics::msgTypeIndex(uint8_t type)
+{
+  if(type >= sizeof(sMsgTypeIndexes))
+  {
+    return RMSN_METRICS_NO_INDEX;
+  }
+
+  return pgm_read_byte(&sMsgTypeIndexes[type]);
+}
@@ -0,0 +1,101 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_8590F9ABA3D211E7AA6EA088B4D1658C
+#define __INCLUDED_8590F9ABA3D211E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+/// Message types defined by the protocol, the unused values below
+/// RMSNMT_WILLMSGRESP are not counted.
+#define RMSN_METRICS_MSG_TYPES   27
+/// RMSNMetrics::msgTypeIndex() of a type that's not counted
+#define RMSN_METRICS_NO_INDEX    0xFF
+/// Bucket i counts response times in [2^i, 2^(i+1)) milliseconds, bucket 0
+/// also counts 0 ms and the last bucket everything slower.
+#define RMSN_METRICS_RTT_BUCKETS 16
+
+/**
+ * @brief The RMSNMetrics struct
+ *
+ * Fixed size counters of a client, all counters wrap around on overflow.
+ *
+ * Frames are counted per message type, indexed by msgTypeIndex():
+ *
+ * @code
+ * metrics->txFrames[RMSNMetrics::msgTypeIndex(RMSNMT_PUBLISH)]
+ * @endcode
+ *
+ * Bytes are counted in total, and per message type the same way with
+ * RMSN_USE_METRICS_BYTES.
+ */
+struct RMSNMetrics
+{
+  uint16_t txFrames[RMSN_METRICS_MSG_TYPES];
+  uint16_t rxFrames[RMSN_METRICS_MSG_TYPES];
+  /// Bytes of all counted frames
+  uint32_t txBytes;
+  uint32_t rxBytes;
+#ifdef RMSN_USE_METRICS_BYTES
+  uint32_t txTypeBytes[RMSN_METRICS_MSG_TYPES];
+  uint32_t rxTypeBytes[RMSN_METRICS_MSG_TYPES];
+#endif
+
+  uint16_t retransmissions;
+  uint16_t timeouts;
+  /// Responses received while we were not waiting for them
+  uint16_t unmatchedResponses;
+  /// Frames dropped because of an invalid length for their type, or
+  /// because the stream stalled in the middle of them
+  uint16_t malformedFrames;
+  /// Retransmitted QoS 1 publishes acknowledged but not delivered again
+  uint16_t duplicatePublishes;
+  /// Sessions renewed after a lost connection
+  uint16_t reconnects;
+  /// Milliseconds from the loss of the connection to the renewal of its
+  /// session, of the last reconnection.
+  uint32_t reconnectTime;
+
+  uint16_t rttHistogram[RMSN_METRICS_RTT_BUCKETS];
+
+  void
+  reset();
+
+  void
+  countTx(const RMSNMsgHeader *msg);
+  void
+  countRx(const RMSNMsgHeader *msg);
+  void
+  recordRtt(uint32_t rtt);
+
+  static uint8_t
+  rttBucket(uint32_t rtt);
+  /// Index of a message type in the frame counters, RMSN_METRICS_NO_INDEX
+  /// if the type is not counted.
+  static uint8_t
+  msgTypeIndex(uint8_t type);
+};
+
+#endif // __INCLUDED_8590F9ABA3D211E7AA6EA088B4D1658C
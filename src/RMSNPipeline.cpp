@@ -0,0 +1,155 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "RMSNPipeline.h"
+
+RMSNPipeline::RMSNPipeline(RMSNPipelineSendCallback send,
+                           RMSNTimerCallback timeout, void *context) :
+  mSend(send),
+  mTimeout(timeout),
+  mContext(context),
+  mTimer(onTimerExpired, this),
+  mPending(0),
+  mMessageId(0),
+  mCount(0),
+  mNext(0),
+  mInFlight(0),
+  mRetries(0)
+{
+}
+
+RMSNPipeline::~RMSNPipeline()
+{
+  RMSNTimerWheel::instance()->cancel(&mTimer);
+}
+
+void
+RMSNPipeline::start(const uint8_t count, const uint16_t messageId)
+{
+  mMessageId = messageId;
+  mCount     = count;
+  mNext      = 0;
+  mInFlight  = 0;
+  mPending   = 0;
+  mRetries   = RMSN_N_RETRY;
+
+  fill();
+}
+
+void
+RMSNPipeline::cancel()
+{
+  RMSNTimerWheel::instance()->cancel(&mTimer);
+
+  mCount    = 0;
+  mPending  = 0;
+  mInFlight = 0;
+}
+
+bool
+RMSNPipeline::isActive() const
+{
+  return mCount > 0;
+}
+
+int8_t
+RMSNPipeline::find(const uint16_t messageId) const
+{
+  const uint16_t item = messageId - mMessageId;
+
+  if((item >= mCount) || !(mPending & (static_cast<RMSNPipelineMask>(1) << item)))
+  {
+    return -1;
+  }
+
+  return static_cast<int8_t>(item);
+}
+
+bool
+RMSNPipeline::acknowledge(const uint8_t item)
+{
+  mPending &= ~(static_cast<RMSNPipelineMask>(1) << item);
+  --mInFlight;
+  mRetries  = RMSN_N_RETRY;
+
+  fill();
+
+  if(mInFlight > 0)
+  {
+    return false;
+  }
+
+  cancel();
+  return true;
+}
+
+void
+RMSNPipeline::onTimerExpired(void *context)
+{
+  static_cast<RMSNPipeline *>(context)->onTimerTimeout();
+}
+
+void
+RMSNPipeline::onTimerTimeout()
+{
+  if(!isActive())
+  {
+    return;
+  }
+
+  if(mRetries <= 0)
+  {
+    cancel();
+    mTimeout(mContext);
+    return;
+  }
+
+  --mRetries;
+
+  for(uint8_t i = 0; i < mNext; ++i)
+  {
+    if(mPending & (static_cast<RMSNPipelineMask>(1) << i))
+    {
+      mSend(mContext, i, mMessageId + i);
+    }
+  }
+
+  RMSNTimerWheel::instance()->arm(&mTimer, RMSN_T_RETRY * 1000L);
+}
+
+void
+RMSNPipeline::fill()
+{
+  while((mNext < mCount) && (mInFlight < RMSN_PIPELINE_WINDOW))
+  {
+    mPending |= static_cast<RMSNPipelineMask>(1) << mNext;
+    ++mInFlight;
+    mSend(mContext, mNext, mMessageId + mNext);
+    ++mNext;
+  }
+
+  // Counted from the last progress.
+  RMSNTimerWheel::instance()->arm(&mTimer, RMSN_T_RETRY * 1000L);
+}
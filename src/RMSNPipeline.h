@@ -0,0 +1,116 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+#ifndef __INCLUDED_7C3E91A0F21B11E7AA6EA088B4D1658C
+#define __INCLUDED_7C3E91A0F21B11E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+#include "RMSNTimerWheel.h"
+
+/// Items a pipeline could carry, the width of its pending bitmask. The
+/// session renewal carries the registered topics, up to 10, and the
+/// subscriptions, so more than 22 subscriptions take the wider mask.
+#if defined(RMSN_MAX_SUBSCRIPTIONS) && (RMSN_MAX_SUBSCRIPTIONS > 22)
+#define RMSN_PIPELINE_MAX_ITEMS 64
+typedef uint64_t RMSNPipelineMask;
+#else
+#define RMSN_PIPELINE_MAX_ITEMS 32
+typedef uint32_t RMSNPipelineMask;
+#endif
+/// Items in flight at once, so that the acknowledgements don't overrun the
+/// gateway or the serial buffers.
+#define RMSN_PIPELINE_WINDOW    4
+
+/// Send item, numbered messageId, again or for the first time.
+typedef void (*RMSNPipelineSendCallback)(void *context, uint8_t item,
+                                         uint16_t messageId);
+
+/**
+ * @brief Requests sent without waiting for each other's response
+ *
+ * Items take consecutive message ids from the one given to start(), so an
+ * acknowledgement is matched to its item whatever the order it comes in.
+ * Up to RMSN_PIPELINE_WINDOW items are in flight, the next one is sent as
+ * an acknowledgement frees the window. Items still in flight are sent
+ * again every RMSN_T_RETRY seconds without progress; after RMSN_N_RETRY
+ * retransmissions the pipeline is cancelled and the timeout callback
+ * called.
+ *
+ * The owner builds and parses the frames, the pipeline only tracks them.
+ */
+class RMSNPipeline
+{
+public:
+  RMSNPipeline(RMSNPipelineSendCallback send, RMSNTimerCallback timeout,
+               void *context);
+  ~RMSNPipeline();
+
+  /// Start sending count items, count in [1, RMSN_PIPELINE_MAX_ITEMS].
+  void
+  start(const uint8_t count, const uint16_t messageId);
+  /// Stop without calling any callback.
+  void
+  cancel();
+
+  /// True from start() until all items are acknowledged or it's cancelled.
+  bool
+  isActive() const;
+  /// @return The item in flight numbered messageId, -1 if none.
+  int8_t
+  find(const uint16_t messageId) const;
+  /**
+   * @brief Acknowledge an item in flight and fill the window again
+   *
+   * @return true if it was the last item, the pipeline is done.
+   */
+  bool
+  acknowledge(const uint8_t item);
+
+private:
+  static void
+  onTimerExpired(void *context);
+  void
+  onTimerTimeout();
+  void
+  fill();
+
+private:
+  RMSNPipelineSendCallback mSend;
+  RMSNTimerCallback        mTimeout;
+  void                    *mContext;
+  /// Retransmits the items in flight when no acknowledgement came.
+  RMSNTimerEntry           mTimer;
+  /// Bit i is set while item i is sent and not acknowledged
+  RMSNPipelineMask         mPending;
+  /// Message id of the first item
+  uint16_t                 mMessageId;
+  /// 0 while not active
+  uint8_t                  mCount;
+  /// Items below it were sent at least once
+  uint8_t                  mNext;
+  uint8_t                  mInFlight;
+  uint8_t                  mRetries;
+};
+
+#endif // __INCLUDED_7C3E91A0F21B11E7AA6EA088B4D1658C
@@ -0,0 +1,52 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include <RByteOrder.h>
+#include "RMSNPublishTemplate.h"
+
+RMSNPublishTemplate::RMSNPublishTemplate() : mMaxDataSize(0), mGeneration(0)
+{
+  memset(&mHeader, 0, sizeof(mHeader));
+  mHeader.type = RMSNMT_INVALID;
+}
+
+bool
+RMSNPublishTemplate::isValid() const
+{
+  return RMSNMT_PUBLISH == mHeader.type;
+}
+
+uint16_t
+RMSNPublishTemplate::topicId() const
+{
+  return rNtohs(mHeader.topicId);
+}
+
+uint8_t
+RMSNPublishTemplate::maxDataSize() const
+{
+  return mMaxDataSize;
+}
@@ -0,0 +1,75 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_2E8A4C50E52811E7AA6EA088B4D1658C
+#define __INCLUDED_2E8A4C50E52811E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+/**
+ * @brief A publish header encoded once for a fixed topic
+ *
+ * Made by RMSNClient::publishTemplate(). Publishing through it copies the
+ * cached header and only patches the message id and the length, for
+ * topics published at a high rate:
+ *
+ * @code
+ * static RMSNPublishTemplate sTelemetry;
+ *
+ * sTelemetry = client.publishTemplate(topic->id, RMSN_FLAG_QOS_0);
+ * ...
+ * client.publish(sTelemetry, &sample, sizeof(sample));
+ * @endcode
+ *
+ * It captures the client flags and codec topics as they are when it's
+ * made, make it again after changing them. The topic id is only valid for
+ * the session it was made in: after a lost connection the client refuses
+ * it, make it again once RMSNClient::reconnected is emitted.
+ */
+class RMSNPublishTemplate
+{
+public:
+  /// An invalid template, publishing through it does nothing.
+  RMSNPublishTemplate();
+
+  bool
+  isValid() const;
+  uint16_t
+  topicId() const;
+  /// Largest payload of the topic
+  uint8_t
+  maxDataSize() const;
+
+private:
+  /// Everything but the message id is final, length has no payload.
+  RMSNMsgPublish mHeader;
+  uint8_t        mMaxDataSize;
+  /// RMSNClient session generation the topic id belongs to
+  uint8_t        mGeneration;
+
+  friend class RMSNClient;
+};
+
+#endif // __INCLUDED_2E8A4C50E52811E7AA6EA088B4D1658C
@@ -1,34 +1,81 @@
 #include "RMSNPublisher.h"
 #include "RMSNClient.h"
 
-RMSNPublisher::RMSNPublisher(RMSNClient *client)
-  : mClient(client)
+static uint8_t sInvalidPayload;
+
+RMSNPublisher::RMSNPublisher(RMSNClient *client, const uint8_t slot,
+                             uint8_t *payload, size_t size)
+  : mClient(client), mSlot(slot)
 {
+  if(client)
+  {
+    mPayloadStream.setBuffer(payload, size);
+  }
+  else
+  {
+    mPayloadStream.setBuffer(&sInvalidPayload, 0);
+  }
 }
 
-RMSNPublisher::RMSNPublisher(const RMSNPublisher &other)
-  : mClient(other.mClient)
+RMSNPublisher::RMSNPublisher(RMSNPublisher &&other)
+  : mClient(other.mClient), mSlot(other.mSlot),
+  mPayloadStream(other.mPayloadStream)
 {
   other.mClient = NULL;
 }
 
 RMSNPublisher::~RMSNPublisher()
 {
-  if(mClient)
+  commit();
+}
+
+RMSNPublisher &
+RMSNPublisher::operator =(RMSNPublisher &&other)
+{
+  if(this != &other)
   {
-    mClient->publishEnd();
+    // The frame we own is finished by the assignment.
+    commit();
+
+    mClient        = other.mClient;
+    mSlot          = other.mSlot;
+    mPayloadStream = other.mPayloadStream;
+    other.mClient  = NULL;
   }
+
+  return *this;
 }
 
-RMSNPublisher &
-RMSNPublisher::operator =(const RMSNPublisher &other)
+bool
+RMSNPublisher::isValid() const
 {
-  mClient       = other.mClient;
-  other.mClient = NULL;
+  return mClient != NULL;
 }
 
 RBufferStream *
 RMSNPublisher::payloadStream()
 {
-  return mClient->pubPayloadStream();
+  return &mPayloadStream;
+}
+
+RMSNRequest
+RMSNPublisher::request() const
+{
+  if(!mClient)
+  {
+    return RMSNRequest();
+  }
+
+  return RMSNRequest(mClient, mClient->mPublishRequests[mSlot]);
+}
+
+void
+RMSNPublisher::commit()
+{
+  if(mClient)
+  {
+    mClient->publishEnd(mSlot,
+                        static_cast<uint8_t>(mPayloadStream.available()));
+    mClient = NULL;
+  }
 }
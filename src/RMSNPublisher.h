@@ -2,23 +2,60 @@
 #define __INCLUDED_018164CE6DDA11E7AA6EA088B4D1658C
 
 #include "RMSNTypes.h"
+#include "RMSNRequest.h"
+#include <RBufferStream.h>
 
-class RBufferStream;
 class RMSNClient;
+
+/**
+ * @brief The RMSNPublisher class
+ *
+ * Owns one frame of the client's publish pool while alive, the payload is
+ * written straight into it. Destroying the publisher commits the publish.
+ * It could be moved but not copied.
+ */
 class RMSNPublisher
 {
 public:
-  RMSNPublisher(RMSNClient *client);
-  RMSNPublisher(const RMSNPublisher &other);
+  /**
+   * @param client NULL for an invalid publisher
+   * @param slot Pool frame owned by the publisher
+   * @param payload Payload area of the publish frame
+   * @param size Maximum payload size
+   */
+  RMSNPublisher(RMSNClient *client, const uint8_t slot, uint8_t *payload,
+                size_t size);
+  RMSNPublisher(RMSNPublisher &&other);
   ~RMSNPublisher();
 
   RMSNPublisher &
-  operator =(const RMSNPublisher &other);
+  operator =(RMSNPublisher &&other);
+
+  RMSNPublisher(const RMSNPublisher &other) = delete;
+  RMSNPublisher &
+  operator =(const RMSNPublisher &other) = delete;
+
+  /// False if no frame was free, writes to the payload stream are dropped.
+  bool
+  isValid() const;
+
   RBufferStream *
   payloadStream();
 
+  /// The request completes once the publish is sent, or acknowledged for
+  /// QoS 1.
+  RMSNRequest
+  request() const;
+
+private:
+  void
+  commit();
+
 private:
-  mutable RMSNClient *mClient;
+  RMSNClient *mClient;
+  uint8_t     mSlot;
+  /// Writes directly into the frame, only lives as long as the publisher.
+  RBufferStream mPayloadStream;
 };
 
 #endif // __INCLUDED_018164CE6DDA11E7AA6EA088B4D1658C
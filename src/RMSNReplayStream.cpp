@@ -0,0 +1,288 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include "RMSNReplayStream.h"
+
+RMSNReplayStream::RMSNReplayStream(Stream *capture, const bool realTime)
+  : mCapture(capture)
+  , mIsRealTime(realTime)
+  , mIsStarted(false)
+  , mIsValid(false)
+  , mIsFinished(false)
+  , mNextDirection(RMSNCD_RX)
+  , mNextTimestamp(0)
+  , mNextOffset(0)
+  , mFirstTimestamp(0)
+  , mStartTime(0)
+  , mFramesReplayed(0)
+  , mFramesMatched(0)
+  , mFramesMissing(0)
+  , mFramesUnexpected(0)
+{
+}
+
+int
+RMSNReplayStream::available()
+{
+  skipMissing();
+
+  if(mIsFinished || (RMSNCD_RX != mNextDirection) || !isNextDue())
+  {
+    return 0;
+  }
+
+  return mNext.length() - mNextOffset;
+}
+
+int
+RMSNReplayStream::read()
+{
+  if(available() <= 0)
+  {
+    return -1;
+  }
+
+  uint8_t c = mNext.data()[mNextOffset++];
+
+  if(mNextOffset >= mNext.length())
+  {
+    ++mFramesReplayed;
+    loadNext();
+  }
+
+  return c;
+}
+
+int
+RMSNReplayStream::peek()
+{
+  if(available() <= 0)
+  {
+    return -1;
+  }
+
+  return mNext.data()[mNextOffset];
+}
+
+size_t
+RMSNReplayStream::write(uint8_t c)
+{
+  if(!mWritten.push(c))
+  {
+    return 1;
+  }
+
+  if(!mIsStarted)
+  {
+    loadNext();
+  }
+
+  if(!mIsFinished && (RMSNCD_TX == mNextDirection) && mWritten.isComplete() &&
+     (mNext.length() == mWritten.length()) &&
+     (0 == memcmp(mNext.data(), mWritten.data(), mWritten.length())))
+  {
+    ++mFramesMatched;
+    loadNext();
+  }
+  else
+  {
+    ++mFramesUnexpected;
+  }
+
+  mWritten.reset();
+
+  return 1;
+}
+
+size_t
+RMSNReplayStream::write(const uint8_t *buffer, size_t size)
+{
+  for(size_t i = 0; i < size; ++i)
+  {
+    write(buffer[i]);
+  }
+
+  return size;
+}
+
+void
+RMSNReplayStream::flush()
+{
+}
+
+uint32_t
+RMSNReplayStream::run(RMSNClient *client)
+{
+  const uint32_t startTime = micros();
+
+  while(!isFinished())
+  {
+    client->parseStream();
+  }
+
+  const uint32_t elapsed = micros() - startTime;
+
+  if(0 == elapsed)
+  {
+    return 0;
+  }
+
+  return static_cast<uint32_t>(mFramesReplayed * 1000000ULL / elapsed);
+}
+
+bool
+RMSNReplayStream::isFinished() const
+{
+  return mIsStarted && mIsFinished;
+}
+
+bool
+RMSNReplayStream::isValid() const
+{
+  return mIsValid;
+}
+
+uint16_t
+RMSNReplayStream::framesReplayed() const
+{
+  return mFramesReplayed;
+}
+
+uint16_t
+RMSNReplayStream::framesMatched() const
+{
+  return mFramesMatched;
+}
+
+uint16_t
+RMSNReplayStream::framesMissing() const
+{
+  return mFramesMissing;
+}
+
+uint16_t
+RMSNReplayStream::framesUnexpected() const
+{
+  return mFramesUnexpected;
+}
+
+void
+RMSNReplayStream::loadNext()
+{
+  const bool isFirst = !mIsStarted;
+
+  mNext.reset();
+  mNextOffset = 0;
+
+  if(isFirst)
+  {
+    mIsStarted  = true;
+    mIsValid    = true;
+    mIsFinished = true;
+
+    for(uint8_t i = 0; i < sizeof(RMSN_CAPTURE_MAGIC) - 1; ++i)
+    {
+      if(mCapture->read() != RMSN_CAPTURE_MAGIC[i])
+      {
+        mIsValid = false;
+        return;
+      }
+    }
+  }
+
+  // Frames a capture could not hold were never recorded, whatever else
+  // does not fit ends the replay.
+  mIsFinished = true;
+
+  int     c = 0;
+  uint8_t header[5];
+
+  for(uint8_t i = 0; i < sizeof(header); ++i)
+  {
+    if((c = mCapture->read()) < 0)
+    {
+      return;
+    }
+
+    header[i] = static_cast<uint8_t>(c);
+  }
+
+  mNextTimestamp = static_cast<uint32_t>(header[0]) |
+                   (static_cast<uint32_t>(header[1]) << 8) |
+                   (static_cast<uint32_t>(header[2]) << 16) |
+                   (static_cast<uint32_t>(header[3]) << 24);
+  mNextDirection = header[4];
+
+  do
+  {
+    if((c = mCapture->read()) < 0)
+    {
+      return;
+    }
+  } while(!mNext.push(static_cast<uint8_t>(c)));
+
+  if(!mNext.isComplete())
+  {
+    return;
+  }
+
+  if(isFirst)
+  {
+    mFirstTimestamp = mNextTimestamp;
+    mStartTime      = millis();
+  }
+
+  mIsFinished = false;
+}
+
+void
+RMSNReplayStream::skipMissing()
+{
+  if(!mIsStarted)
+  {
+    loadNext();
+  }
+
+  // Responses are written by dispatch() before the client reads again, so
+  // a transmission still expected by then was never written.
+  while(!mIsFinished && (RMSNCD_TX == mNextDirection) &&
+        (0 == mWritten.length()))
+  {
+    ++mFramesMissing;
+    loadNext();
+  }
+}
+
+bool
+RMSNReplayStream::isNextDue() const
+{
+  if(!mIsRealTime)
+  {
+    return true;
+  }
+
+  return (millis() - mStartTime) >= (mNextTimestamp - mFirstTimestamp);
+}
@@ -0,0 +1,139 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_AB955F36E58A11E7AA6EA088B4D1658C
+#define __INCLUDED_AB955F36E58A11E7AA6EA088B4D1658C
+
+#include "RMSNCaptureStream.h"
+
+/**
+ * @brief A Stream playing the gateway side of a RMSNCaptureStream capture
+ *
+ * Received frames of the capture are fed to the client in order, either as
+ * fast as it reads them or at their recorded times. Frames the client
+ * writes are checked against the transmitted frames of the capture:
+ *
+ * @code
+ * RMSNReplayStream replay(&captureFile);
+ *
+ * client.begin(&replay);
+ * uint32_t rate = replay.run(&client);
+ * // replay.framesMissing() and replay.framesUnexpected() should be 0
+ * @endcode
+ *
+ * Only frames sent by dispatch() itself, like PUBACK or will answers, are
+ * reproduced by run(). A captured frame the application sent on its own is
+ * counted as missing unless the application repeats the call when the
+ * replay reaches it. Retransmissions count as unexpected frames.
+ */
+class RMSNReplayStream : public Stream
+{
+public:
+  /**
+   * @param capture  Capture to replay, starting with RMSN_CAPTURE_MAGIC.
+   * @param realTime Feed received frames at their recorded times instead
+   * of as soon as they are read.
+   */
+  RMSNReplayStream(Stream *capture, const bool realTime=false);
+
+  int
+  available();
+  int
+  read();
+  int
+  peek();
+  size_t
+  write(uint8_t c);
+  size_t
+  write(const uint8_t *buffer, size_t size);
+  void
+  flush();
+
+  /**
+   * @brief Run the client's parseStream() until the capture ends.
+   *
+   * @return Received frames dispatched per second.
+   */
+  uint32_t
+  run(RMSNClient *client);
+
+  /// The capture ended, or it was not a valid capture.
+  bool
+  isFinished() const;
+  /// The capture started with RMSN_CAPTURE_MAGIC.
+  bool
+  isValid() const;
+
+  /// Received frames fed to the client
+  uint16_t
+  framesReplayed() const;
+  /// Written frames equal to the captured ones
+  uint16_t
+  framesMatched() const;
+  /// Captured frames the client did not write
+  uint16_t
+  framesMissing() const;
+  /// Written frames not in the capture, or different from it
+  uint16_t
+  framesUnexpected() const;
+
+private:
+  /// Load the next record of the capture, isFinished() at its end.
+  void
+  loadNext();
+  /// Skip captured transmissions the client did not write.
+  void
+  skipMissing();
+  bool
+  isNextDue() const;
+
+private:
+  Stream          *mCapture;
+  bool             mIsRealTime;
+  bool             mIsStarted;
+  bool             mIsValid;
+  bool             mIsFinished;
+
+  /// Next record of the capture
+  RMSNCaptureFrame mNext;
+  uint8_t          mNextDirection;
+  uint32_t         mNextTimestamp;
+  /// Bytes of a received mNext already read by the client
+  uint16_t         mNextOffset;
+
+  /// Timestamp of the first record and millis() when it was loaded
+  uint32_t         mFirstTimestamp;
+  uint32_t         mStartTime;
+
+  /// Frame being written by the client
+  RMSNCaptureFrame mWritten;
+
+  uint16_t         mFramesReplayed;
+  uint16_t         mFramesMatched;
+  uint16_t         mFramesMissing;
+  uint16_t         mFramesUnexpected;
+};
+
+#endif // __INCLUDED_AB955F36E58A11E7AA6EA088B4D1658C
@@ -0,0 +1,73 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include "RMSNRequest.h"
+#include "RMSNClient.h"
+
+RMSNRequest::RMSNRequest(RMSNClient *client, const uint8_t id)
+  : mClient(client), mId(id)
+{
+}
+
+uint8_t
+RMSNRequest::id() const
+{
+  return mId;
+}
+
+RMSNRequestResult
+RMSNRequest::result() const
+{
+  if(!mClient || (0 == mId))
+  {
+    return RMSNRR_CANCELLED;
+  }
+
+  return mClient->requestResult(mId);
+}
+
+bool
+RMSNRequest::isDone() const
+{
+  return result() != RMSNRR_PENDING;
+}
+
+void
+RMSNRequest::onComplete(RMSNRequestCallback callback, void *context) const
+{
+  if(mClient && (mId != 0))
+  {
+    mClient->setRequestCallback(mId, callback, context);
+  }
+  else if(callback)
+  {
+    callback(context, mId, RMSNRR_CANCELLED);
+  }
+}
+
+RMSNRequest::operator bool() const
+{
+  return mClient && (mId != 0);
+}
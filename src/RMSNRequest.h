@@ -0,0 +1,113 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_A3C6B1B0E1A411E7AA6EA088B4D1658C
+#define __INCLUDED_A3C6B1B0E1A411E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+class RMSNClient;
+
+/**
+ * Outcome of a request, the first values are the RMSNReturnCode the
+ * gateway answered with.
+ */
+enum RMSNRequestResult
+{
+  RMSNRR_ACCEPTED                  = RMSNRC_ACCEPTED,
+  RMSNRR_REJECTED_CONGESTION       = RMSNRC_REJECTED_CONGESTION,
+  RMSNRR_REJECTED_INVALID_TOPIC_ID = RMSNRC_REJECTED_INVALID_TOPIC_ID,
+  RMSNRR_REJECTED_NOT_SUPPORTED    = RMSNRC_REJECTED_NOT_SUPPORTED,
+  /// Waiting to be sent or for the response
+  RMSNRR_PENDING,
+  /// No response after all retries
+  RMSNRR_TIMEOUT,
+  /// Never sent, or replaced by a newer request before its response came.
+  /// QoS 1 publishes are never replaced, requests are refused meanwhile.
+  RMSNRR_CANCELLED,
+  /// Completed too long ago, the result is not kept anymore
+  RMSNRR_UNKNOWN,
+};
+
+/**
+ * @brief Called once when a request completes
+ *
+ * It's called from RMSNClient::parseStream() or the response timer, new
+ * requests could be issued from it.
+ */
+typedef void (*RMSNRequestCallback)(void *context, uint8_t requestId,
+                                    RMSNRequestResult result);
+
+/**
+ * @brief Handle of a request sent by RMSNClient
+ *
+ * It's only a client pointer and an id, so it's cheap to copy and keep.
+ * The client remembers the results of its last RMSN_MAX_REQUESTS requests.
+ *
+ * @code
+ * static void
+ * onRegistered(void *context, uint8_t requestId, RMSNRequestResult result)
+ * {
+ *   if(RMSNRR_ACCEPTED == result)
+ *   {
+ *     ...
+ *   }
+ * }
+ *
+ * client.registerTopic("sensors/t").onComplete(onRegistered, NULL);
+ * @endcode
+ */
+class RMSNRequest
+{
+public:
+  RMSNRequest(RMSNClient *client = NULL, const uint8_t id = 0);
+
+  uint8_t
+  id() const;
+
+  RMSNRequestResult
+  result() const;
+
+  /// True once the result is anything but RMSNRR_PENDING.
+  bool
+  isDone() const;
+
+  /**
+   * @brief Set the completion callback
+   *
+   * If the request is already done, the callback is called immediately.
+   */
+  void
+  onComplete(RMSNRequestCallback callback, void *context) const;
+
+  /// False if the request could not be issued at all.
+  explicit operator bool() const;
+
+private:
+  RMSNClient *mClient;
+  uint8_t     mId;
+};
+
+#endif // __INCLUDED_A3C6B1B0E1A411E7AA6EA088B4D1658C
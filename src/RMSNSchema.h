@@ -0,0 +1,455 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_315ADDC0DBB511E7AA6EA088B4D1658C
+#define __INCLUDED_315ADDC0DBB511E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+/**
+ * Compact schema driven payload serialization.
+ *
+ * A schema lists the fields of a record, they are written in order straight
+ * into a Print (such as RMSNPublisher::payloadStream()) and read back from
+ * the received payload, without intermediate buffers:
+ *
+ * @code
+ * struct Sample
+ * {
+ *   uint16_t id;
+ *   int16_t  temperature;
+ *   uint32_t pressure;
+ *   bool     hasPressure;
+ * };
+ *
+ * typedef RMSNSchema<
+ *   RMSNField<Sample, uint16_t, &Sample::id>,
+ *   RMSNField<Sample, int16_t, &Sample::temperature, RMSNFE_ZIGZAG>,
+ *   RMSNOptionalField<Sample, uint32_t, &Sample::pressure,
+ *                     &Sample::hasPressure> > SampleSchema;
+ *
+ * SampleSchema::encode(sample, publisher.payloadStream());
+ * SampleSchema::decode(sample, RMSNPayloadReader(msg));
+ * @endcode
+ *
+ * If a schema has optional fields, the payload starts with a varint bitmap
+ * of the present ones, in schema order. Up to 32 optional fields are
+ * supported.
+ */
+
+enum RMSNFieldEncoding
+{
+  /// sizeof(T) bytes in network byte order
+  RMSNFE_FIXED,
+  /// LEB128 varint, for unsigned values
+  RMSNFE_VARINT,
+  /// Zigzag then LEB128 varint, for signed values
+  RMSNFE_ZIGZAG,
+};
+
+/**
+ * @brief The RMSNPayloadReader class
+ *
+ * Bounds checked reading of a received payload. Reading past the end
+ * returns zeros and marks the reader invalid.
+ */
+class RMSNPayloadReader
+{
+public:
+  RMSNPayloadReader(const uint8_t *data, const uint8_t size) :
+    mData(data), mSize(size), mPosition(0), mIsValid(true)
+  {
+  }
+
+  RMSNPayloadReader(const RMSNMsgPublish *msg) :
+    mData(reinterpret_cast<const uint8_t *>(msg->data)),
+    mSize(0), mPosition(0), mIsValid(msg->length >= sizeof(RMSNMsgPublish))
+  {
+    if(mIsValid)
+    {
+      mSize = msg->length - sizeof(RMSNMsgPublish);
+    }
+  }
+
+  uint8_t
+  read()
+  {
+    if(mPosition >= mSize)
+    {
+      mIsValid = false;
+      return 0;
+    }
+
+    return mData[mPosition++];
+  }
+
+  bool
+  isValid() const
+  {
+    return mIsValid;
+  }
+
+  uint8_t
+  remaining() const
+  {
+    return mSize - mPosition;
+  }
+
+private:
+  const uint8_t *mData;
+  uint8_t        mSize;
+  uint8_t        mPosition;
+  bool           mIsValid;
+};
+
+template <uint8_t size>
+struct RMSNUnsignedOf;
+
+template <>
+struct RMSNUnsignedOf<1>
+{
+  typedef uint8_t Type;
+};
+
+template <>
+struct RMSNUnsignedOf<2>
+{
+  typedef uint16_t Type;
+};
+
+template <>
+struct RMSNUnsignedOf<4>
+{
+  typedef uint32_t Type;
+};
+
+template <>
+struct RMSNUnsignedOf<8>
+{
+  typedef uint64_t Type;
+};
+
+template <typename T, uint8_t encoding>
+struct RMSNFieldCoder
+{
+  typedef typename RMSNUnsignedOf<sizeof(T)>::Type Unsigned;
+
+  static bool
+  encode(const T &value, Print *output)
+  {
+    Unsigned bits;
+
+    memcpy(&bits, &value, sizeof(T));
+
+    if(RMSNFE_FIXED == encoding)
+    {
+      for(int8_t i = sizeof(T) - 1; i >= 0; --i)
+      {
+        if(output->write(static_cast<uint8_t>(bits >> (i * 8))) != 1)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    if(RMSNFE_ZIGZAG == encoding)
+    {
+      // Arithmetic shift of the sign bit over the whole value.
+      const Unsigned sign = (bits >> (sizeof(T) * 8 - 1)) ? ~Unsigned(0) : 0;
+
+      bits = static_cast<Unsigned>(bits << 1) ^ sign;
+    }
+
+    do
+    {
+      uint8_t c = bits & 0x7F;
+
+      bits >>= 7;
+
+      if(bits)
+      {
+        c |= 0x80;
+      }
+
+      if(output->write(c) != 1)
+      {
+        return false;
+      }
+    } while(bits);
+
+    return true;
+  }
+
+  static bool
+  decode(T &value, RMSNPayloadReader &input)
+  {
+    Unsigned bits = 0;
+
+    if(RMSNFE_FIXED == encoding)
+    {
+      for(uint8_t i = 0; i < sizeof(T); ++i)
+      {
+        bits = static_cast<Unsigned>(bits << 8) | input.read();
+      }
+    }
+    else
+    {
+      uint8_t shift = 0;
+      uint8_t c;
+
+      do
+      {
+        c = input.read();
+
+        if(shift >= sizeof(T) * 8)
+        {
+          // Too long for the field type.
+          return false;
+        }
+
+        const uint8_t room = sizeof(T) * 8 - shift;
+
+        if((room < 7) && ((c & 0x7F) >> room))
+        {
+          // Bits beyond the field type.
+          return false;
+        }
+
+        bits  |= static_cast<Unsigned>(c & 0x7F) << shift;
+        shift += 7;
+      } while((c & 0x80) && input.isValid());
+
+      if(RMSNFE_ZIGZAG == encoding)
+      {
+        bits = (bits >> 1) ^ (~(bits & 1) + 1);
+      }
+    }
+
+    memcpy(&value, &bits, sizeof(T));
+
+    return input.isValid();
+  }
+};
+
+/**
+ * @brief A field always present in the payload
+ */
+template <typename Record, typename T, T Record::*member,
+          uint8_t encoding=RMSNFE_VARINT>
+struct RMSNField
+{
+  static const bool isOptional = false;
+
+  static bool
+  isPresent(const Record &)
+  {
+    return true;
+  }
+
+  static void
+  setPresent(Record &, const bool)
+  {
+  }
+
+  static bool
+  encode(const Record &record, Print *output)
+  {
+    return RMSNFieldCoder<T, encoding>::encode(record.*member, output);
+  }
+
+  static bool
+  decode(Record &record, RMSNPayloadReader &input)
+  {
+    return RMSNFieldCoder<T, encoding>::decode(record.*member, input);
+  }
+};
+
+/**
+ * @brief A field only written if the record's presence flag is set
+ */
+template <typename Record, typename T, T Record::*member,
+          bool Record::*present, uint8_t encoding=RMSNFE_VARINT>
+struct RMSNOptionalField : public RMSNField<Record, T, member, encoding>
+{
+  static const bool isOptional = true;
+
+  static bool
+  isPresent(const Record &record)
+  {
+    return record.*present;
+  }
+
+  static void
+  setPresent(Record &record, const bool isPresent)
+  {
+    record.*present = isPresent;
+  }
+};
+
+template <typename ... Fields>
+struct RMSNFieldList;
+
+template <>
+struct RMSNFieldList<>
+{
+  static const uint8_t optionalCount = 0;
+
+  template <typename Record>
+  static uint32_t
+  presence(const Record &, const uint8_t)
+  {
+    return 0;
+  }
+
+  template <typename Record>
+  static bool
+  encode(const Record &, Print *)
+  {
+    return true;
+  }
+
+  template <typename Record>
+  static bool
+  decode(Record &, RMSNPayloadReader &, const uint32_t, const uint8_t)
+  {
+    return true;
+  }
+};
+
+template <typename Field, typename ... Rest>
+struct RMSNFieldList<Field, Rest ...>
+{
+  typedef RMSNFieldList<Rest ...> Next;
+
+  static const uint8_t optionalCount =
+    (Field::isOptional ? 1 : 0) + Next::optionalCount;
+
+  template <typename Record>
+  static uint32_t
+  presence(const Record &record, const uint8_t bit)
+  {
+    if(!Field::isOptional)
+    {
+      return Next::presence(record, bit);
+    }
+
+    uint32_t mask = Next::presence(record, bit + 1);
+
+    if(Field::isPresent(record))
+    {
+      mask |= 1UL << bit;
+    }
+
+    return mask;
+  }
+
+  template <typename Record>
+  static bool
+  encode(const Record &record, Print *output)
+  {
+    if(Field::isPresent(record) && !Field::encode(record, output))
+    {
+      return false;
+    }
+
+    return Next::encode(record, output);
+  }
+
+  template <typename Record>
+  static bool
+  decode(Record &record, RMSNPayloadReader &input, const uint32_t presence,
+         const uint8_t bit)
+  {
+    bool isPresent = true;
+
+    if(Field::isOptional)
+    {
+      isPresent = presence & (1UL << bit);
+      Field::setPresent(record, isPresent);
+    }
+
+    if(isPresent && !Field::decode(record, input))
+    {
+      return false;
+    }
+
+    return Next::decode(record, input, presence,
+                        bit + (Field::isOptional ? 1 : 0));
+  }
+};
+
+/**
+ * @brief The RMSNSchema struct
+ */
+template <typename ... Fields>
+struct RMSNSchema
+{
+  typedef RMSNFieldList<Fields ...> List;
+
+  static_assert(List::optionalCount <= 32, "Too many optional fields");
+
+  /**
+   * @return false if the output is full, the payload is incomplete then.
+   */
+  template <typename Record>
+  static bool
+  encode(const Record &record, Print *output)
+  {
+    if(List::optionalCount > 0)
+    {
+      const uint32_t presence = List::presence(record, 0);
+
+      if(!RMSNFieldCoder<uint32_t, RMSNFE_VARINT>::encode(presence, output))
+      {
+        return false;
+      }
+    }
+
+    return List::encode(record, output);
+  }
+
+  /**
+   * @return false if the payload is truncated or malformed, fields are
+   * partially decoded then.
+   */
+  template <typename Record>
+  static bool
+  decode(Record &record, RMSNPayloadReader input)
+  {
+    uint32_t presence = 0;
+
+    if((List::optionalCount > 0)
+       && !RMSNFieldCoder<uint32_t, RMSNFE_VARINT>::decode(presence, input))
+    {
+      return false;
+    }
+
+    return List::decode(record, input, presence, 0);
+  }
+};
+
+#endif // __INCLUDED_315ADDC0DBB511E7AA6EA088B4D1658C
@@ -0,0 +1,156 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include "RMSNSubmitQueue.h"
+
+#ifdef __AVR__
+#include <util/atomic.h>
+#endif
+
+#define RMSN_SUBMIT_MASK (RMSN_SUBMIT_QUEUE_SIZE - 1)
+
+static inline RMSNSubmitPosition
+loadAcquire(const volatile RMSNSubmitPosition *value)
+{
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+storeRelease(volatile RMSNSubmitPosition *value,
+             const RMSNSubmitPosition newValue)
+{
+  __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+RMSNSubmitQueue::RMSNSubmitQueue() : mTail(0), mHead(0)
+{
+  for(uint8_t i = 0; i < RMSN_SUBMIT_QUEUE_SIZE; ++i)
+  {
+    // Slot i is free for the producer at position i.
+    mSlots[i].sequence = i;
+  }
+}
+
+bool
+RMSNSubmitQueue::reserve(RMSNSubmitPosition &position)
+{
+  for(;;)
+  {
+    position = loadAcquire(&mTail);
+
+    const RMSNSubmitDistance distance = static_cast<RMSNSubmitDistance>(
+      loadAcquire(&mSlots[position & RMSN_SUBMIT_MASK].sequence) - position);
+
+    if(distance < 0)
+    {
+      // The consumer has not released the slot yet, we are full.
+      return false;
+    }
+
+    if(distance > 0)
+    {
+      // Another producer took this position, retry with the new tail.
+      continue;
+    }
+
+#ifdef __AVR__
+    bool reserved = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      if(mTail == position)
+      {
+        mTail    = position + 1;
+        reserved = true;
+      }
+    }
+
+    if(reserved)
+    {
+      return true;
+    }
+
+#else
+    RMSNSubmitPosition expected = position;
+
+    if(__atomic_compare_exchange_n(&mTail, &expected,
+                                   static_cast<RMSNSubmitPosition>(
+                                     position + 1), false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+      return true;
+    }
+
+#endif
+  }
+}
+
+bool
+RMSNSubmitQueue::submit(const uint16_t topicId, const void *data,
+                        const uint8_t dataLen, const uint8_t qos)
+{
+  RMSNSubmitPosition position;
+
+  if((dataLen > RMSN_SUBMIT_DATA_SIZE) || !reserve(position))
+  {
+    return false;
+  }
+
+  RMSNSubmission &slot = mSlots[position & RMSN_SUBMIT_MASK];
+
+  slot.qos     = qos;
+  slot.topicId = topicId;
+  slot.dataLen = dataLen;
+  memcpy(slot.data, data, dataLen);
+
+  // Hand the slot to the consumer.
+  storeRelease(&slot.sequence, position + 1);
+  return true;
+}
+
+const RMSNSubmission *
+RMSNSubmitQueue::front() const
+{
+  const RMSNSubmission &slot = mSlots[mHead & RMSN_SUBMIT_MASK];
+
+  if(loadAcquire(&slot.sequence)
+     != static_cast<RMSNSubmitPosition>(mHead + 1))
+  {
+    return NULL;
+  }
+
+  return &slot;
+}
+
+void
+RMSNSubmitQueue::pop()
+{
+  RMSNSubmission &slot = mSlots[mHead & RMSN_SUBMIT_MASK];
+
+  // Free for the producer one lap later.
+  storeRelease(&slot.sequence, mHead + RMSN_SUBMIT_QUEUE_SIZE);
+  ++mHead;
+}
@@ -0,0 +1,113 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_C1E05F30E2B611E7AA6EA088B4D1658C
+#define __INCLUDED_C1E05F30E2B611E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+/// Slots of the queue, must be a power of two not larger than 64.
+#define RMSN_SUBMIT_QUEUE_SIZE 4
+/// Largest payload a submission could carry
+#define RMSN_SUBMIT_DATA_SIZE  16
+
+#ifdef __AVR__
+/// Position in the queue, wrapping around. 8 bits are enough for
+/// interrupt handlers, see RMSNSubmitQueue.
+typedef uint8_t RMSNSubmitPosition;
+typedef int8_t  RMSNSubmitDistance;
+#else
+/// Position in the queue, wrapping around. 32 bits for threads that may be
+/// preempted for long, see RMSNSubmitQueue.
+typedef uint32_t RMSNSubmitPosition;
+typedef int32_t  RMSNSubmitDistance;
+#endif
+
+/**
+ * @brief A queued publish
+ */
+struct RMSNSubmission
+{
+  /// Position the slot is ready for, see RMSNSubmitQueue.
+  volatile RMSNSubmitPosition sequence;
+  uint8_t                     qos;
+  uint16_t                    topicId;
+  uint8_t                     dataLen;
+  uint8_t                     data[RMSN_SUBMIT_DATA_SIZE];
+};
+
+/**
+ * @brief Bounded multi-producer, single-consumer publish queue
+ *
+ * Lets interrupt handlers publish through a client without touching its
+ * frames: producers copy the publish into a preallocated slot, and the
+ * client sends the queued publishes from its idle loop, see
+ * RMSNClient::setSubmitQueue().
+ *
+ * Every slot carries a sequence number telling whether it's free for the
+ * producer at that position or filled for the consumer, so a producer never
+ * waits for another one. Only the reservation of a position is atomic: a
+ * compare and swap where the compiler has one, a short interrupt-free
+ * section on AVR. A producer must not be suspended in submit() while a
+ * full lap of positions goes through, or its reservation could succeed on
+ * a stale position. On AVR positions are 8 bits, 256 submissions, which
+ * can't happen to an interrupt handler. Elsewhere producers may be threads
+ * the scheduler preempts for long, positions are 32 bits there.
+ */
+class RMSNSubmitQueue
+{
+public:
+  RMSNSubmitQueue();
+
+  /**
+   * @brief Queue a publish, safe to call from interrupt handlers
+   *
+   * @return false if the queue is full or the payload is larger than
+   * RMSN_SUBMIT_DATA_SIZE.
+   */
+  bool
+  submit(const uint16_t topicId, const void *data, const uint8_t dataLen,
+         const uint8_t qos);
+
+  /// The oldest queued publish, NULL if none. Consumer only.
+  const RMSNSubmission *
+  front() const;
+  /// Release the slot returned by front(). Consumer only.
+  void
+  pop();
+
+private:
+  bool
+  reserve(RMSNSubmitPosition &position);
+
+private:
+  RMSNSubmission              mSlots[RMSN_SUBMIT_QUEUE_SIZE];
+  /// Next position producers reserve
+  volatile RMSNSubmitPosition mTail;
+  /// Next position the consumer reads
+  RMSNSubmitPosition          mHead;
+};
+
+#endif // __INCLUDED_C1E05F30E2B611E7AA6EA088B4D1658C
@@ -0,0 +1,225 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include <RSignal.h>
+#include "RMSNTimerWheel.h"
+
+#define RMSN_TIMER_WHEEL_MASK (RMSN_TIMER_WHEEL_SLOTS - 1)
+
+static inline void
+linkInit(RMSNTimerLink *link)
+{
+  link->next = link;
+  link->prev = link;
+}
+
+static inline void
+linkRemove(RMSNTimerLink *link)
+{
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  linkInit(link);
+}
+
+static inline void
+linkAppend(RMSNTimerLink *head, RMSNTimerLink *link)
+{
+  link->prev       = head->prev;
+  link->next       = head;
+  head->prev->next = link;
+  head->prev       = link;
+}
+
+RMSNTimerEntry::RMSNTimerEntry(RMSNTimerCallback callback, void *context)
+  : callback(callback), context(context), rounds(0)
+{
+  linkInit(this);
+}
+
+bool
+RMSNTimerEntry::isArmed() const
+{
+  return next != this;
+}
+
+RMSNTimerWheel *
+RMSNTimerWheel::instance()
+{
+  // Created on first use, after the application's event loop exists.
+  static RMSNTimerWheel sWheel;
+
+  return &sWheel;
+}
+
+RMSNTimerWheel::RMSNTimerWheel() : mCurrent(0), mArmedCount(0), mTickTime(0)
+{
+  for(uint8_t i = 0; i < RMSN_TIMER_WHEEL_SLOTS; ++i)
+  {
+    linkInit(&mSlots[i]);
+  }
+
+  mTimer.setSingleShot(false);
+  mTimer.setInterval(RMSN_TIMER_WHEEL_TICK);
+  R_CONNECT(&mTimer, timeout, this, onTimerTimeout);
+}
+
+void
+RMSNTimerWheel::arm(RMSNTimerEntry *entry, const uint32_t interval)
+{
+  cancel(entry);
+
+  if(0 == mArmedCount)
+  {
+    mTickTime = millis();
+    mTimer.start();
+  }
+
+  // Expires on the tick after the interval elapsed, never earlier.
+  const uint32_t ticks = (interval + RMSN_TIMER_WHEEL_TICK - 1)
+                         / RMSN_TIMER_WHEEL_TICK + 1;
+
+  entry->rounds = static_cast<uint16_t>((ticks - 1) / RMSN_TIMER_WHEEL_SLOTS);
+  linkAppend(&mSlots[(mCurrent + ticks) & RMSN_TIMER_WHEEL_MASK], entry);
+  ++mArmedCount;
+}
+
+void
+RMSNTimerWheel::cancel(RMSNTimerEntry *entry)
+{
+  if(!entry->isArmed())
+  {
+    return;
+  }
+
+  linkRemove(entry);
+
+  if(0 == --mArmedCount)
+  {
+    mTimer.stop();
+  }
+}
+
+uint32_t
+RMSNTimerWheel::nextDeadline() const
+{
+  if(0 == mArmedCount)
+  {
+    return RMSN_TIMER_WHEEL_NO_DEADLINE;
+  }
+
+  uint32_t ticks = RMSN_TIMER_WHEEL_NO_DEADLINE;
+
+  // Slots are visited in the order they expire, the first slot holding an
+  // entry of the current turn ends the search.
+  for(uint8_t i = 1; i <= RMSN_TIMER_WHEEL_SLOTS; ++i)
+  {
+    const RMSNTimerLink *slot =
+      &mSlots[(mCurrent + i) & RMSN_TIMER_WHEEL_MASK];
+
+    for(const RMSNTimerLink *link = slot->next; link != slot;
+        link = link->next)
+    {
+      const uint32_t entryTicks =
+        i + static_cast<uint32_t>(
+          static_cast<const RMSNTimerEntry *>(link)->rounds)
+        * RMSN_TIMER_WHEEL_SLOTS;
+
+      if(entryTicks < ticks)
+      {
+        ticks = entryTicks;
+      }
+    }
+
+    if(ticks <= RMSN_TIMER_WHEEL_SLOTS)
+    {
+      break;
+    }
+  }
+
+  const uint32_t elapsed  = millis() - mTickTime;
+  const uint32_t interval = ticks * RMSN_TIMER_WHEEL_TICK;
+
+  return (elapsed >= interval) ? 0 : (interval - elapsed);
+}
+
+void
+RMSNTimerWheel::onTimerTimeout()
+{
+  // The timer may fire late when the loop is busy, catch up with the ticks
+  // we missed.
+  while((mArmedCount > 0)
+        && (millis() - mTickTime >= RMSN_TIMER_WHEEL_TICK))
+  {
+    mTickTime += RMSN_TIMER_WHEEL_TICK;
+    advance();
+  }
+}
+
+void
+RMSNTimerWheel::advance()
+{
+  mCurrent = (mCurrent + 1) & RMSN_TIMER_WHEEL_MASK;
+
+  RMSNTimerLink *slot = &mSlots[mCurrent];
+  RMSNTimerLink  expired;
+
+  // Entries are moved out of the slot before any callback runs, callbacks
+  // may arm or cancel any entry, including the ones still in the list.
+  linkInit(&expired);
+
+  if(slot->next != slot)
+  {
+    expired.next       = slot->next;
+    expired.prev       = slot->prev;
+    expired.next->prev = &expired;
+    expired.prev->next = &expired;
+    linkInit(slot);
+  }
+
+  while(expired.next != &expired)
+  {
+    RMSNTimerEntry *entry = static_cast<RMSNTimerEntry *>(expired.next);
+
+    linkRemove(entry);
+
+    if(entry->rounds > 0)
+    {
+      --entry->rounds;
+      linkAppend(slot, entry);
+      continue;
+    }
+
+    if(0 == --mArmedCount)
+    {
+      mTimer.stop();
+    }
+
+    if(entry->callback)
+    {
+      entry->callback(entry->context);
+    }
+  }
+}
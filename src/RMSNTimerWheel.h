@@ -0,0 +1,127 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_4F1B2D60E37C11E7AA6EA088B4D1658C
+#define __INCLUDED_4F1B2D60E37C11E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+#include <RObject.h>
+#include <RTimer.h>
+
+/// Milliseconds per tick of the wheel, the resolution of all timers.
+#define RMSN_TIMER_WHEEL_TICK  100
+/// Slots of the wheel, must be a power of two.
+#define RMSN_TIMER_WHEEL_SLOTS 16
+/// RMSNTimerWheel::nextDeadline() when no entry is armed
+#define RMSN_TIMER_WHEEL_NO_DEADLINE 0xFFFFFFFFUL
+
+typedef void (*RMSNTimerCallback)(void *context);
+
+/**
+ * @brief Node of the circular lists hanging from the wheel slots
+ */
+struct RMSNTimerLink
+{
+  RMSNTimerLink *next;
+  RMSNTimerLink *prev;
+};
+
+/**
+ * @brief A one shot timer armed on RMSNTimerWheel
+ *
+ * The entry is owned by the object it times, the wheel only links it, so
+ * arming never allocates. It must be cancelled before it's destroyed.
+ */
+struct RMSNTimerEntry : public RMSNTimerLink
+{
+  RMSNTimerEntry(RMSNTimerCallback callback = NULL, void *context = NULL);
+
+  bool
+  isArmed() const;
+
+  RMSNTimerCallback callback;
+  void             *context;
+  /// Full turns of the wheel left before it expires
+  uint16_t          rounds;
+};
+
+/**
+ * @brief Hashed timing wheel shared by all clients
+ *
+ * One RTimer ticks the wheel, and only while some entry is armed. Arming
+ * and cancelling are O(1); each tick only visits the entries of one slot.
+ */
+class RMSNTimerWheel : public RObject
+{
+public:
+  static RMSNTimerWheel *
+  instance();
+
+  /// Expire entry after interval milliseconds, rearming moves it.
+  void
+  arm(RMSNTimerEntry *entry, const uint32_t interval);
+  void
+  cancel(RMSNTimerEntry *entry);
+
+  /**
+   * @brief Milliseconds until the earliest armed entry expires
+   *
+   * 0 if it's already due, RMSN_TIMER_WHEEL_NO_DEADLINE if nothing is
+   * armed. A sketch in readiness driven mode could sleep until then, the
+   * receive interrupt wakes it earlier:
+   *
+   * @code
+   * if(RMSNTimerWheel::instance()->nextDeadline() > RMSN_TIMER_WHEEL_TICK)
+   * {
+   *   set_sleep_mode(SLEEP_MODE_IDLE);
+   *   sleep_mode();
+   * }
+   * @endcode
+   *
+   * The millis() interrupt also wakes the MCU in idle mode, so the deadline
+   * is only a hint whether sleeping is worth it at all.
+   */
+  uint32_t
+  nextDeadline() const;
+
+private:
+  RMSNTimerWheel();
+
+  void
+  onTimerTimeout();
+  /// Expire the entries of the next slot.
+  void
+  advance();
+
+private:
+  RTimer        mTimer;
+  RMSNTimerLink mSlots[RMSN_TIMER_WHEEL_SLOTS];
+  uint8_t       mCurrent;
+  uint16_t      mArmedCount;
+  /// millis() of the last tick
+  uint32_t      mTickTime;
+};
+
+#endif // __INCLUDED_4F1B2D60E37C11E7AA6EA088B4D1658C
@@ -0,0 +1,180 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include <RByteOrder.h>
+#include "RMSNTrace.h"
+
+#ifdef RMSN_USE_TRACE
+
+RMSNTraceRecord RMSNTrace::sRecords[RMSN_TRACE_RECORDS];
+uint8_t         RMSNTrace::sHead  = 0;
+uint8_t         RMSNTrace::sCount = 0;
+
+void
+RMSNTrace::record(const RMSNTraceEvent event, const RMSNMsgHeader *msg)
+{
+  RMSNTraceRecord record;
+
+  record.timestamp = millis();
+  record.event     = event;
+  record.type      = msg->type;
+  record.flags     = 0;
+  record.length    = msg->length;
+  record.messageId = 0;
+  record.topicId   = 0;
+
+  switch(msg->type)
+  {
+  case RMSNMT_REGISTER:
+  case RMSNMT_REGACK:
+  case RMSNMT_PUBACK:
+    {
+      auto fields = reinterpret_cast<const RMSNMsgRegAck *>(msg);
+
+      record.topicId   = rNtohs(fields->topicId);
+      record.messageId = rNtohs(fields->messageId);
+    }
+    break;
+
+  case RMSNMT_PUBLISH:
+    {
+      auto fields = reinterpret_cast<const RMSNMsgPublish *>(msg);
+
+      record.flags     = fields->flags;
+      record.topicId   = rNtohs(fields->topicId);
+      record.messageId = rNtohs(fields->messageId);
+    }
+    break;
+
+  case RMSNMT_SUBACK:
+    {
+      auto fields = reinterpret_cast<const RMSNMsgSubAck *>(msg);
+
+      record.flags     = fields->flags;
+      record.topicId   = rNtohs(fields->topicId);
+      record.messageId = rNtohs(fields->messageId);
+    }
+    break;
+
+  case RMSNMT_SUBSCRIBE:
+  case RMSNMT_UNSUBSCRIBE:
+    {
+      auto fields = reinterpret_cast<const RMSNMsgSubscribe *>(msg);
+
+      record.flags     = fields->flags;
+      record.messageId = rNtohs(fields->messageId);
+
+      if((fields->flags & RMSN_TOPIC_MASK) != RMSN_FLAG_TOPIC_NAME)
+      {
+        record.topicId = rNtohs(fields->topicId);
+      }
+    }
+    break;
+
+  case RMSNMT_PUBCOMP:
+  case RMSNMT_PUBREC:
+  case RMSNMT_PUBREL:
+  case RMSNMT_UNSUBACK:
+    record.messageId =
+      rNtohs(reinterpret_cast<const RMSNMsgPubQos2 *>(msg)->messageId);
+    break;
+
+  default:
+    break;
+  }
+
+  push(record);
+}
+
+void
+RMSNTrace::recordState(const uint8_t from, const uint8_t to)
+{
+  RMSNTraceRecord record;
+
+  memset(&record, 0, sizeof(record));
+  record.timestamp = millis();
+  record.event     = RMSNTE_STATE;
+  record.type      = to;
+  record.flags     = from;
+
+  push(record);
+}
+
+void
+RMSNTrace::clear()
+{
+  sHead  = 0;
+  sCount = 0;
+}
+
+void
+RMSNTrace::dump(Print *output)
+{
+  output->write(reinterpret_cast<const uint8_t *>(RMSN_TRACE_MAGIC),
+                sizeof(RMSN_TRACE_MAGIC) - 1);
+  writeLittleEndian(output, sizeof(RMSNTraceRecord), 1);
+  writeLittleEndian(output, sCount, 2);
+
+  for(uint8_t i = 0; i < sCount; ++i)
+  {
+    const RMSNTraceRecord &record =
+      sRecords[(sHead + RMSN_TRACE_RECORDS - sCount + i) % RMSN_TRACE_RECORDS];
+
+    writeLittleEndian(output, record.timestamp, 4);
+    output->write(record.event);
+    output->write(record.type);
+    output->write(record.flags);
+    output->write(record.length);
+    writeLittleEndian(output, record.messageId, 2);
+    writeLittleEndian(output, record.topicId, 2);
+  }
+
+  output->flush();
+}
+
+void
+RMSNTrace::push(const RMSNTraceRecord &record)
+{
+  sRecords[sHead] = record;
+  sHead           = (sHead + 1) % RMSN_TRACE_RECORDS;
+
+  if(sCount < RMSN_TRACE_RECORDS)
+  {
+    ++sCount;
+  }
+}
+
+void
+RMSNTrace::writeLittleEndian(Print *output, uint32_t value, uint8_t size)
+{
+  while(size-- > 0)
+  {
+    output->write(static_cast<uint8_t>(value));
+    value >>= 8;
+  }
+}
+
+#endif // RMSN_USE_TRACE
@@ -0,0 +1,121 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_BB2F7564C11B11E7AA6EA088B4D1658C
+#define __INCLUDED_BB2F7564C11B11E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+/// Records kept in the ring buffer, the oldest record is overwritten first.
+#define RMSN_TRACE_RECORDS 32
+
+/// Dump header: magic, record size, record count
+#define RMSN_TRACE_MAGIC "RTR1"
+
+enum RMSNTraceEvent
+{
+  RMSNTE_SEND,
+  RMSNTE_RECEIVE,
+  RMSNTE_DISPATCH,
+  /// A received response we were not waiting for
+  RMSNTE_UNMATCHED,
+  RMSNTE_TIMEOUT,
+  RMSNTE_RETRY,
+  /// Response to wait for changed, type is the new one, flags the old one.
+  RMSNTE_STATE,
+  /// A received frame with a length invalid for its type, it was dropped.
+  RMSNTE_MALFORMED,
+} RMSN_STRUCT_PACKED;
+
+/**
+ * @brief The RMSNTraceRecord struct
+ *
+ * Fields are stored in host order, dump() writes them in little endian.
+ */
+struct RMSNTraceRecord
+{
+  uint32_t timestamp; ///< millis()
+  uint8_t  event;     ///< RMSNTraceEvent
+  uint8_t  type;      ///< RMSNMsgType
+  uint8_t  flags;
+  uint8_t  length;
+  uint16_t messageId;
+  uint16_t topicId;
+} RMSN_STRUCT_PACKED;
+
+/**
+ * @brief The RMSNTrace class
+ *
+ * A RAM ring buffer of protocol events shared by all clients. Use the
+ * RMSN_TRACE() macros, they compile to nothing unless RMSN_USE_TRACE is
+ * defined.
+ */
+class RMSNTrace
+{
+public:
+  static void
+  record(const RMSNTraceEvent event, const RMSNMsgHeader *msg);
+  static void
+  recordState(const uint8_t from, const uint8_t to);
+
+  static void
+  clear();
+
+  /**
+   * @brief Write all records, oldest first, in binary form.
+   *
+   * The output starts with RMSN_TRACE_MAGIC, one byte of record size and
+   * two bytes of record count, decode it with tools/rmsn-trace-decode.py.
+   */
+  static void
+  dump(Print *output);
+
+private:
+  static void
+  push(const RMSNTraceRecord &record);
+  static void
+  writeLittleEndian(Print *output, uint32_t value, uint8_t size);
+
+private:
+  static RMSNTraceRecord sRecords[RMSN_TRACE_RECORDS];
+  static uint8_t         sHead;
+  static uint8_t         sCount;
+};
+
+#ifdef RMSN_USE_TRACE
+#define RMSN_TRACE(event, msg)     RMSNTrace::record((event), (msg))
+#define RMSN_TRACE_STATE(from, to) RMSNTrace::recordState((from), (to))
+#else
+#define RMSN_TRACE(event, msg) \
+  do \
+  { \
+  } while(0)
+#define RMSN_TRACE_STATE(from, to) \
+  do \
+  { \
+  } while(0)
+#endif
+
+#endif // __INCLUDED_BB2F7564C11B11E7AA6EA088B4D1658C
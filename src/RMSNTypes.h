@@ -27,6 +27,7 @@
 #define __INCLUDED_FDCE12F8526A11E7AA6EA088B4D1658C
 
 #include <Arduino.h>
+#include "RMSNConfig.h"
 
 #define RMSN_PROTOCOL_ID 0x01
 
@@ -0,0 +1,337 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include "RMSNValueCache.h"
+
+#define RMSN_VALUE_CACHE_INDEX_MASK (RMSN_VALUE_CACHE_TOPICS * 2 - 1)
+
+RMSNValueCache::RMSNValueCache()
+{
+  clear();
+}
+
+bool
+RMSNValueCache::watch(const uint16_t topicId, const uint8_t maxSize)
+{
+  if(find(topicId) >= 0)
+  {
+    return true;
+  }
+
+  const int8_t entry = addEntry(maxSize);
+
+  if(entry < 0)
+  {
+    return false;
+  }
+
+  mEntries[entry].topicId = topicId;
+  indexId(entry);
+
+  return true;
+}
+
+bool
+RMSNValueCache::watch(const char *topicName, const uint8_t maxSize)
+{
+  if(find(topicName) >= 0)
+  {
+    return true;
+  }
+
+  const int8_t entry = addEntry(maxSize);
+
+  if(entry < 0)
+  {
+    return false;
+  }
+
+  mEntries[entry].name = topicName;
+  indexName(entry);
+
+  return true;
+}
+
+void
+RMSNValueCache::clear()
+{
+  memset(mEntries, 0, sizeof(mEntries));
+  memset(mIdIndex, 0, sizeof(mIdIndex));
+  memset(mNameIndex, 0, sizeof(mNameIndex));
+  mEntryCount = 0;
+  mArenaUsed  = 0;
+}
+
+RMSNSpan
+RMSNValueCache::value(const uint16_t topicId) const
+{
+  return valueOf(find(topicId));
+}
+
+RMSNSpan
+RMSNValueCache::value(const char *topicName) const
+{
+  return valueOf(find(topicName));
+}
+
+uint16_t
+RMSNValueCache::generation(const uint16_t topicId) const
+{
+  const int8_t entry = find(topicId);
+
+  return (entry < 0) ? 0 : mEntries[entry].generation;
+}
+
+uint16_t
+RMSNValueCache::generation(const char *topicName) const
+{
+  const int8_t entry = find(topicName);
+
+  return (entry < 0) ? 0 : mEntries[entry].generation;
+}
+
+bool
+RMSNValueCache::store(const uint16_t topicId, const uint8_t *data,
+                      const uint8_t length)
+{
+  const int8_t entry = find(topicId);
+
+  if(entry < 0)
+  {
+    return false;
+  }
+
+  Entry &slot = mEntries[entry];
+
+  if(length > slot.capacity)
+  {
+    return true;
+  }
+
+  memcpy(mArena + slot.offset, data, length);
+  slot.length = length;
+
+  if(0 == ++slot.generation)
+  {
+    // 0 is kept for never received.
+    slot.generation = 1;
+  }
+
+  return true;
+}
+
+bool
+RMSNValueCache::bind(const char *topicName, const uint16_t topicId)
+{
+  const int8_t entry = find(topicName);
+
+  if(entry < 0)
+  {
+    return false;
+  }
+
+  if(mEntries[entry].topicId == topicId)
+  {
+    return true;
+  }
+
+  mEntries[entry].topicId = topicId;
+
+  // The topic may have had another id before a reconnection.
+  reindexIds();
+
+  return true;
+}
+
+void
+RMSNValueCache::unbindAll()
+{
+  for(uint8_t i = 0; i < mEntryCount; ++i)
+  {
+    if(mEntries[i].name)
+    {
+      mEntries[i].topicId = RMSN_INVALID_TOPIC_ID;
+    }
+  }
+
+  reindexIds();
+}
+
+bool
+RMSNValueCache::hasNames() const
+{
+  for(uint8_t i = 0; i < mEntryCount; ++i)
+  {
+    if(mEntries[i].name)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+int8_t
+RMSNValueCache::addEntry(const uint8_t maxSize)
+{
+  if((mEntryCount >= RMSN_VALUE_CACHE_TOPICS)
+     || (maxSize > sizeof(mArena) - mArenaUsed))
+  {
+    return -1;
+  }
+
+  Entry &entry = mEntries[mEntryCount];
+
+  entry.name       = NULL;
+  entry.topicId    = RMSN_INVALID_TOPIC_ID;
+  entry.generation = 0;
+  entry.offset     = mArenaUsed;
+  entry.capacity   = maxSize;
+  entry.length     = 0;
+
+  mArenaUsed += maxSize;
+
+  return mEntryCount++;
+}
+
+int8_t
+RMSNValueCache::find(const uint16_t topicId) const
+{
+  uint8_t position = hash(topicId);
+
+  // The index is never full, an empty position ends the search.
+  while(mIdIndex[position])
+  {
+    const uint8_t entry = mIdIndex[position] - 1;
+
+    if(mEntries[entry].topicId == topicId)
+    {
+      return entry;
+    }
+
+    position = (position + 1) & RMSN_VALUE_CACHE_INDEX_MASK;
+  }
+
+  return -1;
+}
+
+int8_t
+RMSNValueCache::find(const char *topicName) const
+{
+  uint8_t position = hash(topicName);
+
+  while(mNameIndex[position])
+  {
+    const uint8_t entry = mNameIndex[position] - 1;
+
+    if(strcmp(mEntries[entry].name, topicName) == 0)
+    {
+      return entry;
+    }
+
+    position = (position + 1) & RMSN_VALUE_CACHE_INDEX_MASK;
+  }
+
+  return -1;
+}
+
+void
+RMSNValueCache::indexId(const uint8_t entry)
+{
+  uint8_t position = hash(mEntries[entry].topicId);
+
+  while(mIdIndex[position])
+  {
+    position = (position + 1) & RMSN_VALUE_CACHE_INDEX_MASK;
+  }
+
+  mIdIndex[position] = entry + 1;
+}
+
+void
+RMSNValueCache::indexName(const uint8_t entry)
+{
+  uint8_t position = hash(mEntries[entry].name);
+
+  while(mNameIndex[position])
+  {
+    position = (position + 1) & RMSN_VALUE_CACHE_INDEX_MASK;
+  }
+
+  mNameIndex[position] = entry + 1;
+}
+
+void
+RMSNValueCache::reindexIds()
+{
+  // Rebuilt rather than removing from the probe chains.
+  memset(mIdIndex, 0, sizeof(mIdIndex));
+
+  for(uint8_t i = 0; i < mEntryCount; ++i)
+  {
+    if(RMSN_INVALID_TOPIC_ID != mEntries[i].topicId)
+    {
+      indexId(i);
+    }
+  }
+}
+
+RMSNSpan
+RMSNValueCache::valueOf(const int8_t entry) const
+{
+  RMSNSpan span = {mArena, 0};
+
+  if(entry >= 0)
+  {
+    span.data = mArena + mEntries[entry].offset;
+    span.size = mEntries[entry].length;
+  }
+
+  return span;
+}
+
+uint8_t
+RMSNValueCache::hash(uint16_t topicId)
+{
+  topicId ^= topicId >> 8;
+  topicId ^= topicId >> 4;
+
+  return topicId & RMSN_VALUE_CACHE_INDEX_MASK;
+}
+
+uint8_t
+RMSNValueCache::hash(const char *topicName)
+{
+  // FNV-1a, folded
+  uint16_t value = 0x811C;
+
+  while(*topicName)
+  {
+    value = (value ^ static_cast<uint8_t>(*topicName++)) * 0x0193;
+  }
+
+  return hash(value);
+}
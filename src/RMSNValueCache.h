@@ -0,0 +1,149 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_D118B8FBE5A011E7AA6EA088B4D1658C
+#define __INCLUDED_D118B8FBE5A011E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+#include "RMSNView.h"
+
+/// Topics a cache could watch, a power of two.
+#define RMSN_VALUE_CACHE_TOPICS 8
+/// Bytes shared by the values of all watched topics
+#define RMSN_VALUE_CACHE_ARENA  128
+
+/**
+ * @brief The RMSNValueCache class
+ *
+ * Keeps the last payload received on each watched topic, so that modules
+ * read the current value of a topic instead of each one listening to
+ * RMSNClient::received and keeping a copy:
+ *
+ * @code
+ * static RMSNValueCache sValues;
+ *
+ * sValues.watch("setpoint", sizeof(Setpoint));
+ * client.setValueCache(&sValues);
+ * ...
+ * if(sValues.generation("setpoint") != mSeenGeneration)
+ * {
+ *   RMSNSpan value = sValues.value("setpoint");
+ * }
+ * @endcode
+ *
+ * Room for each value is taken from a fixed arena when the topic is
+ * watched. Lookups by topic id and by name are hashed. A topic watched by
+ * name is bound to its id by the client when a value arrives on an id it
+ * does not know, also after the id changed, the name must outlive the
+ * cache. The client unbinds them when a lost session was renewed, as the
+ * gateway may have given their old ids to other topics.
+ *
+ * Each stored value increments the topic's generation, 0 means nothing
+ * was received yet. Payloads larger than the room of their topic are not
+ * cached.
+ */
+class RMSNValueCache
+{
+public:
+  RMSNValueCache();
+
+  /// @return false if there is no room left for the topic.
+  bool
+  watch(const uint16_t topicId, const uint8_t maxSize);
+  bool
+  watch(const char *topicName, const uint8_t maxSize);
+  /// Forget all topics and values.
+  void
+  clear();
+
+  /// The last value, empty if none.
+  RMSNSpan
+  value(const uint16_t topicId) const;
+  RMSNSpan
+  value(const char *topicName) const;
+  uint16_t
+  generation(const uint16_t topicId) const;
+  uint16_t
+  generation(const char *topicName) const;
+
+  /// @return false if the topic id is not watched.
+  bool
+  store(const uint16_t topicId, const uint8_t *data, const uint8_t length);
+  /// Give a topic watched by name its id, false if the name is not watched.
+  bool
+  bind(const char *topicName, const uint16_t topicId);
+  /// Forget the ids of topics watched by name, values are kept.
+  void
+  unbindAll();
+  /// Some topic is watched by name, its id may be unknown or outdated.
+  bool
+  hasNames() const;
+
+private:
+  struct Entry
+  {
+    /// NULL if watched by id only
+    const char *name;
+    /// RMSN_INVALID_TOPIC_ID until bound
+    uint16_t    topicId;
+    uint16_t    generation;
+    uint8_t     offset;
+    uint8_t     capacity;
+    uint8_t     length;
+  };
+
+  /// @return Index of the new entry, -1 if there is no room.
+  int8_t
+  addEntry(const uint8_t maxSize);
+  /// @return Entry index, -1 if not found.
+  int8_t
+  find(const uint16_t topicId) const;
+  int8_t
+  find(const char *topicName) const;
+  void
+  indexId(const uint8_t entry);
+  void
+  indexName(const uint8_t entry);
+  void
+  reindexIds();
+  RMSNSpan
+  valueOf(const int8_t entry) const;
+
+  static uint8_t
+  hash(uint16_t topicId);
+  static uint8_t
+  hash(const char *topicName);
+
+private:
+  Entry   mEntries[RMSN_VALUE_CACHE_TOPICS];
+  uint8_t mEntryCount;
+  /// Entry index + 1 by hash, 0 if empty, probed linearly.
+  uint8_t mIdIndex[RMSN_VALUE_CACHE_TOPICS * 2];
+  uint8_t mNameIndex[RMSN_VALUE_CACHE_TOPICS * 2];
+  uint8_t mArena[RMSN_VALUE_CACHE_ARENA];
+  uint8_t mArenaUsed;
+};
+
+#endif // __INCLUDED_D118B8FBE5A011E7AA6EA088B4D1658C
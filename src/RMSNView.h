@@ -0,0 +1,372 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_7C41E2A0DF0211E7AA6EA088B4D1658C
+#define __INCLUDED_7C41E2A0DF0211E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+/**
+ * Read-only views of received messages.
+ *
+ * A view points into the receive buffer, nothing is copied. Construction
+ * checks the frame is long enough for the fixed fields of the type, the
+ * accessors of an invalid view must not be used. Multi-byte fields are
+ * decoded from network order with byte loads, so they are safe on targets
+ * that can't do unaligned 16-bit access:
+ *
+ * @code
+ * void
+ * onReceived(const RMSNMsgHeader *msg)
+ * {
+ *   RMSNPublishView publish(msg);
+ *
+ *   if(publish.isValid())
+ *   {
+ *     handle(publish.topicId(), publish.payload().data,
+ *            publish.payload().size);
+ *   }
+ * }
+ * @endcode
+ */
+
+/**
+ * @brief Bytes inside a received frame
+ */
+struct RMSNSpan
+{
+  const uint8_t *data;
+  uint8_t        size;
+};
+
+/**
+ * @brief The RMSNMsgView class
+ *
+ * Base of all views, only checks the header itself.
+ */
+class RMSNMsgView
+{
+public:
+  explicit
+  RMSNMsgView(const RMSNMsgHeader *msg,
+              const uint8_t minLength = sizeof(RMSNMsgHeader),
+              const uint8_t type = RMSNMT_INVALID)
+    : mData(reinterpret_cast<const uint8_t *>(msg))
+  {
+    if((NULL == msg)
+       || (msg->length < minLength)
+       || ((RMSNMT_INVALID != type) && (msg->type != type)))
+    {
+      mData = NULL;
+    }
+  }
+
+  bool
+  isValid() const
+  {
+    return mData != NULL;
+  }
+
+  uint8_t
+  length() const
+  {
+    return mData[0];
+  }
+
+  uint8_t
+  type() const
+  {
+    return mData[1];
+  }
+
+  const RMSNMsgHeader *
+  header() const
+  {
+    return reinterpret_cast<const RMSNMsgHeader *>(mData);
+  }
+
+protected:
+  uint8_t
+  byteAt(const uint8_t offset) const
+  {
+    return mData[offset];
+  }
+
+  uint16_t
+  wordAt(const uint8_t offset) const
+  {
+    return (static_cast<uint16_t>(mData[offset]) << 8) | mData[offset + 1];
+  }
+
+  /// The bytes from offset up to the end of the frame
+  RMSNSpan
+  tailFrom(const uint8_t offset) const
+  {
+    RMSNSpan span = {mData + offset, static_cast<uint8_t>(length() - offset)};
+
+    return span;
+  }
+
+private:
+  const uint8_t *mData;
+};
+
+/// Offset of a field following the message header, the structs are not
+/// standard layout so offsetof() can't be used on them.
+#define RMSN_VIEW_FIELD(offset) (sizeof(RMSNMsgHeader) + (offset))
+
+#define RMSN_VIEW_CONSTRUCTOR(View, Msg, Type) \
+  explicit \
+  View(const RMSNMsgHeader *msg) \
+    : RMSNMsgView(msg, sizeof(Msg), Type) \
+  { \
+  }
+
+class RMSNAdvertiseView : public RMSNMsgView
+{
+public:
+  RMSN_VIEW_CONSTRUCTOR(RMSNAdvertiseView, RMSNMsgAdvertise,
+                        RMSNMT_ADVERTISE)
+
+  uint8_t
+  gwId() const
+  {
+    return byteAt(RMSN_VIEW_FIELD(0));
+  }
+
+  uint16_t
+  duration() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(1));
+  }
+};
+
+class RMSNGwInfoView : public RMSNMsgView
+{
+public:
+  RMSN_VIEW_CONSTRUCTOR(RMSNGwInfoView, RMSNMsgGwInfo, RMSNMT_GWINFO)
+
+  uint8_t
+  gwId() const
+  {
+    return byteAt(RMSN_VIEW_FIELD(0));
+  }
+
+  /// Empty if sent by the gateway itself.
+  RMSNSpan
+  gwAddress() const
+  {
+    return tailFrom(sizeof(RMSNMsgGwInfo));
+  }
+};
+
+/**
+ * @brief View of the messages that only carry a return code
+ *
+ * CONNACK, WILLTOPICRESP and WILLMSGRESP.
+ */
+class RMSNReturnCodeView : public RMSNMsgView
+{
+public:
+  explicit
+  RMSNReturnCodeView(const RMSNMsgHeader *msg)
+    : RMSNMsgView(msg, sizeof(RMSNMsgConnAck))
+  {
+  }
+
+  RMSNReturnCode
+  returnCode() const
+  {
+    return static_cast<RMSNReturnCode>(
+      byteAt(RMSN_VIEW_FIELD(0)));
+  }
+};
+
+class RMSNRegisterView : public RMSNMsgView
+{
+public:
+  RMSN_VIEW_CONSTRUCTOR(RMSNRegisterView, RMSNMsgRegister, RMSNMT_REGISTER)
+
+  uint16_t
+  topicId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(0));
+  }
+
+  uint16_t
+  messageId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(2));
+  }
+
+  /// Not NUL terminated.
+  RMSNSpan
+  topicName() const
+  {
+    return tailFrom(sizeof(RMSNMsgRegister));
+  }
+};
+
+/**
+ * @brief View of REGACK and PUBACK, they share the same layout
+ */
+class RMSNTopicAckView : public RMSNMsgView
+{
+public:
+  explicit
+  RMSNTopicAckView(const RMSNMsgHeader *msg)
+    : RMSNMsgView(msg, sizeof(RMSNMsgRegAck))
+  {
+  }
+
+  uint16_t
+  topicId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(0));
+  }
+
+  uint16_t
+  messageId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(2));
+  }
+
+  RMSNReturnCode
+  returnCode() const
+  {
+    return static_cast<RMSNReturnCode>(
+      byteAt(RMSN_VIEW_FIELD(4)));
+  }
+};
+
+class RMSNPublishView : public RMSNMsgView
+{
+public:
+  RMSN_VIEW_CONSTRUCTOR(RMSNPublishView, RMSNMsgPublish, RMSNMT_PUBLISH)
+
+  uint8_t
+  flags() const
+  {
+    return byteAt(RMSN_VIEW_FIELD(0));
+  }
+
+  uint16_t
+  topicId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(1));
+  }
+
+  uint16_t
+  messageId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(3));
+  }
+
+  RMSNSpan
+  payload() const
+  {
+    return tailFrom(sizeof(RMSNMsgPublish));
+  }
+};
+
+class RMSNSubAckView : public RMSNMsgView
+{
+public:
+  RMSN_VIEW_CONSTRUCTOR(RMSNSubAckView, RMSNMsgSubAck, RMSNMT_SUBACK)
+
+  uint8_t
+  flags() const
+  {
+    return byteAt(RMSN_VIEW_FIELD(0));
+  }
+
+  uint16_t
+  topicId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(1));
+  }
+
+  uint16_t
+  messageId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(3));
+  }
+
+  RMSNReturnCode
+  returnCode() const
+  {
+    return static_cast<RMSNReturnCode>(
+      byteAt(RMSN_VIEW_FIELD(5)));
+  }
+};
+
+/**
+ * @brief View of the messages that only carry a message id
+ *
+ * UNSUBACK, PUBREC, PUBREL and PUBCOMP.
+ */
+class RMSNMessageIdView : public RMSNMsgView
+{
+public:
+  explicit
+  RMSNMessageIdView(const RMSNMsgHeader *msg)
+    : RMSNMsgView(msg, sizeof(RMSNMsgUnsubAck))
+  {
+  }
+
+  uint16_t
+  messageId() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(0));
+  }
+};
+
+class RMSNDisconnectView : public RMSNMsgView
+{
+public:
+  explicit
+  RMSNDisconnectView(const RMSNMsgHeader *msg)
+    : RMSNMsgView(msg, sizeof(RMSNMsgHeader), RMSNMT_DISCONNECT)
+  {
+  }
+
+  bool
+  hasDuration() const
+  {
+    return length() >= sizeof(RMSNMsgDisconnect);
+  }
+
+  /// Only valid if hasDuration()
+  uint16_t
+  duration() const
+  {
+    return wordAt(RMSN_VIEW_FIELD(0));
+  }
+};
+
+#undef RMSN_VIEW_CONSTRUCTOR
+#undef RMSN_VIEW_FIELD
+
+#endif // __INCLUDED_7C41E2A0DF0211E7AA6EA088B4D1658C
@@ -0,0 +1,90 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#include <Arduino.h>
+#include "RMSNWill.h"
+
+RMSNWill::RMSNWill()
+{
+  clear();
+}
+
+bool
+RMSNWill::set(const char *topic, const void *message,
+              const uint8_t messageLen, const uint8_t flags)
+{
+  const size_t topicLen = strlen(topic);
+
+  if(sizeof(RMSNMsgWillTopic) + topicLen + sizeof(RMSNMsgWillMsg) + messageLen
+     > RMSN_WILL_BUFFER_SIZE)
+  {
+    clear();
+    return false;
+  }
+
+  RMSNMsgWillTopic *willTopic = reinterpret_cast<RMSNMsgWillTopic *>(mFrames);
+
+  willTopic->length = static_cast<uint8_t>(sizeof(RMSNMsgWillTopic) + topicLen);
+  willTopic->type   = RMSNMT_WILLTOPIC;
+  willTopic->flags  = flags & (RMSN_QOS_MASK | RMSN_FLAG_RETAIN);
+  memcpy(willTopic->willTopic, topic, topicLen);
+
+  RMSNMsgWillMsg *willMsg =
+    reinterpret_cast<RMSNMsgWillMsg *>(mFrames + willTopic->length);
+
+  willMsg->length = sizeof(RMSNMsgWillMsg) + messageLen;
+  willMsg->type   = RMSNMT_WILLMSG;
+  memcpy(willMsg->willmsg, message, messageLen);
+
+  return true;
+}
+
+void
+RMSNWill::clear()
+{
+  RMSNMsgHeader *willTopic = reinterpret_cast<RMSNMsgHeader *>(mFrames);
+
+  willTopic->length = sizeof(RMSNMsgHeader);
+  willTopic->type   = RMSNMT_WILLTOPIC;
+}
+
+bool
+RMSNWill::isSet() const
+{
+  return willTopicFrame()->length > sizeof(RMSNMsgHeader);
+}
+
+const RMSNMsgHeader *
+RMSNWill::willTopicFrame() const
+{
+  return reinterpret_cast<const RMSNMsgHeader *>(mFrames);
+}
+
+const RMSNMsgHeader *
+RMSNWill::willMsgFrame() const
+{
+  return reinterpret_cast<const RMSNMsgHeader *>(mFrames
+                                                 + willTopicFrame()->length);
+}
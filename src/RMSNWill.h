@@ -0,0 +1,73 @@
+/*
+   The MIT License (MIT)
+
+   Copyright (C) 2017 Hong-She Liang <starofrainnight@gmail.com>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+   THE SOFTWARE.
+ */
+
+
+#ifndef __INCLUDED_9D27F0B0E45211E7AA6EA088B4D1658C
+#define __INCLUDED_9D27F0B0E45211E7AA6EA088B4D1658C
+
+#include "RMSNTypes.h"
+
+/// Room for both the WILLTOPIC and the WILLMSG frames
+#define RMSN_WILL_BUFFER_SIZE 64
+
+/**
+ * @brief The RMSNWill class
+ *
+ * The will of a client, kept as the ready to send WILLTOPIC and WILLMSG
+ * frames. Once attached with RMSNClient::setWill(), CONNECT carries the
+ * will flag and the gateway's WILLTOPICREQ and WILLMSGREQ are answered
+ * straight from the dispatch path.
+ */
+class RMSNWill
+{
+public:
+  RMSNWill();
+
+  /**
+   * @brief Encode the will frames
+   *
+   * @param flags QoS and retain flags of the will
+   * @return false if the frames don't fit in RMSN_WILL_BUFFER_SIZE, the
+   * will is cleared then.
+   */
+  bool
+  set(const char *topic, const void *message, const uint8_t messageLen,
+      const uint8_t flags = RMSN_FLAG_QOS_0);
+  void
+  clear();
+  bool
+  isSet() const;
+
+  /// An empty WILLTOPIC if not set, which tells the gateway there's no will.
+  const RMSNMsgHeader *
+  willTopicFrame() const;
+  const RMSNMsgHeader *
+  willMsgFrame() const;
+
+private:
+  /// WILLTOPIC then WILLMSG
+  uint8_t mFrames[RMSN_WILL_BUFFER_SIZE];
+};
+
+#endif // __INCLUDED_9D27F0B0E45211E7AA6EA088B4D1658C
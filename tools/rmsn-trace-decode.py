@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+Decode a RMSNTrace::dump() output into a readable timeline.
+
+The input could be a raw capture of the serial port, text printed before
+the dump is skipped by searching for the magic.
+
+Usage: rmsn-trace-decode.py <capture-file>
+"""
+
+import struct
+import sys
+
+MAGIC = b"RTR1"
+RECORD = struct.Struct("<IBBBBHH")
+
+EVENTS = ["SEND", "RECV", "DISPATCH", "UNMATCHED", "TIMEOUT", "RETRY",
+          "STATE", "MALFORMED"]
+
+MSG_TYPES = {
+    0x00: "ADVERTISE", 0x01: "SEARCHGW", 0x02: "GWINFO", 0x04: "CONNECT",
+    0x05: "CONNACK", 0x06: "WILLTOPICREQ", 0x07: "WILLTOPIC",
+    0x08: "WILLMSGREQ", 0x09: "WILLMSG", 0x0a: "REGISTER", 0x0b: "REGACK",
+    0x0c: "PUBLISH", 0x0d: "PUBACK", 0x0e: "PUBCOMP", 0x0f: "PUBREC",
+    0x10: "PUBREL", 0x12: "SUBSCRIBE", 0x13: "SUBACK", 0x14: "UNSUBSCRIBE",
+    0x15: "UNSUBACK", 0x16: "PINGREQ", 0x17: "PINGRESP", 0x18: "DISCONNECT",
+    0x1a: "WILLTOPICUPD", 0x1b: "WILLTOPICRESP", 0x1c: "WILLMSGUPD",
+    0x1d: "WILLMSGRESP", 0xff: "NONE",
+}
+
+
+def type_name(value):
+    return MSG_TYPES.get(value, "0x%02x" % value)
+
+
+def decode(data):
+    start = data.find(MAGIC)
+    if start < 0:
+        raise ValueError("No trace dump found")
+
+    offset = start + len(MAGIC)
+    record_size, count = struct.unpack_from("<BH", data, offset)
+    offset += 3
+
+    if record_size != RECORD.size:
+        raise ValueError("Unsupported record size %s" % record_size)
+
+    first = None
+    for _ in range(count):
+        if offset + record_size > len(data):
+            raise ValueError("Truncated trace dump")
+
+        (timestamp, event, msg_type, flags, length, message_id,
+         topic_id) = RECORD.unpack_from(data, offset)
+        offset += record_size
+
+        if first is None:
+            first = timestamp
+
+        elapsed = (timestamp - first) & 0xFFFFFFFF
+        event_name = EVENTS[event] if event < len(EVENTS) else str(event)
+
+        if event_name == "STATE":
+            detail = "%s -> %s" % (type_name(flags), type_name(msg_type))
+        else:
+            detail = "%-12s len=%-3d flags=0x%02x msgId=%-5d topicId=%d" % (
+                type_name(msg_type), length, flags, message_id, topic_id)
+
+        yield "%10d ms  %-9s %s" % (elapsed, event_name, detail)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write(__doc__.lstrip())
+        return 1
+
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+
+    for line in decode(data):
+        print(line)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())